@@ -97,30 +97,13 @@ const std::vector<std::string> Defaults = {
 
 namespace Stockfish {
 
-// Builds a list of UCI commands to be run by bench. There
-// are five parameters: TT size in MB, number of search threads that
-// should be used, the limit value spent for each position, a file name
-// where to look for positions in FEN format, and the type of the limit:
-// depth, perft, nodes and movetime (in milliseconds). Examples:
-//
-// bench                            : search default positions up to depth 13
-// bench 64 1 15                    : search default positions up to depth 15 (TT = 64MB)
-// bench 64 1 100000 default nodes  : search default positions for 100K nodes each
-// bench 64 4 5000 current movetime : search current position with 4 threads for 5 sec
-// bench 16 1 5 blah perft          : run a perft 5 on positions in file "blah"
-std::vector<std::string> setup_bench(const Position& current, std::istream& is) {
-
-    std::vector<std::string> fens, list;
-    std::string              go, token;
+namespace {
 
-    // Assign default values to missing arguments
-    std::string ttSize    = (is >> token) ? token : "16";
-    std::string threads   = (is >> token) ? token : "1";
-    std::string limit     = (is >> token) ? token : "13";
-    std::string fenFile   = (is >> token) ? token : "default";
-    std::string limitType = (is >> token) ? token : "depth";
+// Returns the default bench positions, the current position or the ones read
+// from the given FEN file, one per line.
+std::vector<std::string> read_fens(const Position& current, const std::string& fenFile) {
 
-    go = limitType == "eval" ? "eval" : "go " + limitType + " " + limit;
+    std::vector<std::string> fens;
 
     if (fenFile == "default")
         fens = Defaults;
@@ -146,6 +129,38 @@ std::vector<std::string> setup_bench(const Position& current, std::istream& is)
         file.close();
     }
 
+    return fens;
+}
+
+}  // namespace
+
+// Builds a list of UCI commands to be run by bench. There
+// are five parameters: TT size in MB, number of search threads that
+// should be used, the limit value spent for each position, a file name
+// where to look for positions in FEN format, and the type of the limit:
+// depth, perft, nodes and movetime (in milliseconds). Examples:
+//
+// bench                            : search default positions up to depth 13
+// bench 64 1 15                    : search default positions up to depth 15 (TT = 64MB)
+// bench 64 1 100000 default nodes  : search default positions for 100K nodes each
+// bench 64 4 5000 current movetime : search current position with 4 threads for 5 sec
+// bench 16 1 5 blah perft          : run a perft 5 on positions in file "blah"
+std::vector<std::string> setup_bench(const Position& current, std::istream& is) {
+
+    std::vector<std::string> fens, list;
+    std::string              go, token;
+
+    // Assign default values to missing arguments
+    std::string ttSize    = (is >> token) ? token : "16";
+    std::string threads   = (is >> token) ? token : "1";
+    std::string limit     = (is >> token) ? token : "13";
+    std::string fenFile   = (is >> token) ? token : "default";
+    std::string limitType = (is >> token) ? token : "depth";
+
+    go = limitType == "eval" ? "eval" : "go " + limitType + " " + limit;
+
+    fens = read_fens(current, fenFile);
+
     list.emplace_back("setoption name Threads value " + threads);
     list.emplace_back("setoption name Hash value " + ttSize);
     list.emplace_back("ucinewgame");
@@ -162,4 +177,19 @@ std::vector<std::string> setup_bench(const Position& current, std::istream& is)
     return list;
 }
 
+// Builds the list of UCI commands setting up the root positions of evalbench,
+// taken from the same sources as bench: "default", "current" or a FEN file.
+std::vector<std::string> setup_evalbench(const Position& current, const std::string& fenFile) {
+
+    std::vector<std::string> list;
+
+    for (const std::string& fen : read_fens(current, fenFile))
+        if (fen.find("setoption") != std::string::npos)
+            list.emplace_back(fen);
+        else
+            list.emplace_back("position fen " + fen);
+
+    return list;
+}
+
 }  // namespace Stockfish
\ No newline at end of file
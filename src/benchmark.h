@@ -28,6 +28,7 @@ namespace Stockfish {
 class Position;
 
 std::vector<std::string> setup_bench(const Position&, std::istream&);
+std::vector<std::string> setup_evalbench(const Position&, const std::string&);
 
 }  // namespace Stockfish
 
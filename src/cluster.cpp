@@ -0,0 +1,475 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cluster.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+    #include <atomic>
+    #include <cerrno>
+    #include <condition_variable>
+    #include <cstddef>
+    #include <cstring>
+    #include <deque>
+    #include <mutex>
+    #include <thread>
+
+    #include <sys/socket.h>
+    #include <sys/types.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+#include "tt.h"
+
+namespace Stockfish::Cluster {
+
+namespace {
+
+int rankIdx = 0, clusterSize = 1;
+
+#ifndef _WIN32
+
+constexpr int    MaxRanks           = 256;
+constexpr size_t MaxMessageSize     = 1 << 16;
+constexpr size_t MaxReceivedEntries = 1 << 16;  // Entries waiting to be saved
+constexpr auto   VoteTimeout        = std::chrono::seconds(5);
+constexpr size_t MaxVotedPV         = 32;  // Moves of the PV sent with a result
+
+enum MessageType : uint8_t {
+    COMMAND,
+    TT_ENTRIES,
+    RESULT,
+    STOP,
+    SHUTDOWN
+};
+
+struct TTBatch {
+    uint8_t   type;
+    uint8_t   rank;
+    uint16_t  count;
+    TTMessage entries[TTBatchSize];
+};
+
+struct ResultMessage {
+    uint8_t  type;
+    uint8_t  rank;
+    uint16_t pvLength;
+    uint32_t searchId;
+    int32_t  score, depth;
+    uint16_t pv[MaxVotedPV];
+};
+
+struct StopMessage {
+    uint8_t  type;
+    uint8_t  rank;
+    uint32_t searchId;
+};
+
+int         sock = -1;
+std::string socketPrefix;
+std::thread receiver;
+
+// Protect the messages received and not yet consumed
+std::mutex              mutex;
+std::condition_variable cv;
+
+std::deque<std::string>    commands;
+std::vector<TTMessage>     received, applying;
+std::vector<ResultMessage> results;
+uint32_t                   searchCount = 0;
+
+// Id of the last search rank 0 asked to stop, see stop()
+std::atomic<uint32_t> stopId{0};
+
+// Whether a message was ever delivered to a rank, and whether it is dead: it
+// never started listening or its socket is gone. Dead ranks are skipped and
+// left out of the vote.
+std::atomic<bool> reached[MaxRanks], dead[MaxRanks];
+
+sockaddr_un address(int r) {
+    sockaddr_un addr{};
+    std::string path = socketPrefix + "." + std::to_string(r);
+    addr.sun_family  = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+// Sends a message to rank r. Control messages are retried for a while when the
+// rank is not listening yet, deep entries are dropped if they cannot be sent
+// right away, as the search must never wait for the other ranks. A rank that
+// refuses a control message after all the attempts, or any message after it
+// was reached, is marked dead and never waited for again.
+bool send_to(int r, const void* data, size_t len, bool reliable) {
+
+    if (dead[r])
+        return false;
+
+    sockaddr_un addr    = address(r);
+    bool        refused = false;
+
+    for (int attempt = 0; attempt < (reliable ? 1000 : 1); ++attempt)
+    {
+        if (sendto(sock, data, len, reliable ? 0 : MSG_DONTWAIT,
+                   reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))
+            == ssize_t(len))
+            return reached[r] = true;
+
+        refused = errno == ECONNREFUSED || errno == ENOENT;
+
+        if (refused && reached[r])
+            break;
+
+        if (reliable)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    if (refused && (reliable || reached[r]))
+        dead[r] = true;
+
+    return false;
+}
+
+int live_others() {
+    int n = 0;
+    for (int r = 0; r < clusterSize; ++r)
+        n += r != rankIdx && !dead[r];
+    return n;
+}
+
+void send_all(const void* data, size_t len, bool reliable) {
+    for (int r = 0; r < clusterSize; ++r)
+        if (r != rankIdx)
+            send_to(r, data, len, reliable);
+}
+
+// Receives the messages of the other ranks until finalize() sends a shutdown
+// message to this rank.
+void receive_loop() {
+
+    std::vector<char> buf(MaxMessageSize);
+
+    while (true)
+    {
+        ssize_t len = recv(sock, buf.data(), buf.size(), 0);
+
+        if (len <= 0)
+            continue;
+
+        std::lock_guard<std::mutex> lk(mutex);
+
+        switch (buf[0])
+        {
+        case SHUTDOWN :
+            return;
+
+        case COMMAND :
+            commands.emplace_back(buf.data() + 1, size_t(len - 1));
+            cv.notify_all();
+            break;
+
+        case TT_ENTRIES : {
+            if (size_t(len) < offsetof(TTBatch, entries))  // Truncated header
+                break;
+
+            TTBatch batch{};
+            std::memcpy(&batch, buf.data(), std::min(size_t(len), sizeof(batch)));
+            size_t fit   = (size_t(len) - offsetof(TTBatch, entries)) / sizeof(TTMessage);
+            size_t count = std::min<size_t>({batch.count, TTBatchSize, fit});
+
+            if (received.size() + count <= MaxReceivedEntries)
+                received.insert(received.end(), batch.entries, batch.entries + count);
+            break;
+        }
+
+        case STOP :
+            if (size_t(len) == sizeof(StopMessage))
+            {
+                StopMessage msg;
+                std::memcpy(&msg, buf.data(), sizeof(msg));
+                stopId.store(msg.searchId, std::memory_order_relaxed);
+            }
+            break;
+
+        case RESULT :
+            if (size_t(len) == sizeof(ResultMessage))
+            {
+                results.emplace_back();
+                std::memcpy(&results.back(), buf.data(), sizeof(ResultMessage));
+                cv.notify_all();
+            }
+            break;
+        }
+    }
+}
+
+#endif
+
+}  // namespace
+
+
+int rank() { return rankIdx; }
+int size() { return clusterSize; }
+
+
+// Joins the cluster described by the environment, if any. Output of the
+// ranks other than 0 is discarded.
+void init() {
+
+#ifndef _WIN32
+    const char* sizeEnv   = std::getenv("SF_CLUSTER_SIZE");
+    const char* rankEnv   = std::getenv("SF_CLUSTER_RANK");
+    const char* socketEnv = std::getenv("SF_CLUSTER_SOCKET");
+
+    if (!sizeEnv || !rankEnv || std::atoi(sizeEnv) < 2)
+        return;
+
+    clusterSize  = std::min(std::atoi(sizeEnv), MaxRanks);
+    rankIdx      = std::clamp(std::atoi(rankEnv), 0, clusterSize - 1);
+    socketPrefix = socketEnv ? socketEnv : "/tmp/stockfish-cluster";
+
+    sockaddr_un addr = address(rankIdx);
+    unlink(addr.sun_path);
+
+    sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    if (sock < 0 || bind(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        std::cerr << "info string Cannot bind cluster socket " << addr.sun_path << std::endl;
+
+        if (sock >= 0)
+            close(sock);
+
+        sock = -1, clusterSize = 1, rankIdx = 0;
+        return;
+    }
+
+    receiver = std::thread(receive_loop);
+
+    if (!is_root())
+        std::cout.rdbuf(nullptr);
+#endif
+}
+
+
+void finalize() {
+
+#ifndef _WIN32
+    if (clusterSize == 1)
+        return;
+
+    const uint8_t shutdown = SHUTDOWN;
+    send_to(rankIdx, &shutdown, 1, true);
+    receiver.join();
+
+    sockaddr_un addr = address(rankIdx);
+    close(sock);
+    unlink(addr.sun_path);
+#endif
+}
+
+
+bool read_command(std::string& cmd) {
+
+#ifndef _WIN32
+    if (clusterSize > 1 && !is_root())
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [] { return !commands.empty(); });
+        cmd = commands.front();
+        commands.pop_front();
+        return true;
+    }
+#endif
+
+    bool ok = bool(std::getline(std::cin, cmd));
+
+#ifndef _WIN32
+    if (clusterSize > 1)
+    {
+        std::string msg = char(COMMAND) + (ok ? cmd : std::string("quit"));
+        send_all(msg.data(), std::min(msg.size(), MaxMessageSize), true);
+    }
+#endif
+
+    return ok;
+}
+
+
+void save(TTSendBuffer& buffer, Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev) {
+
+    buffer.entries[buffer.count++] = {k,
+                                      int16_t(v),
+                                      int16_t(ev),
+                                      m.raw(),
+                                      uint8_t(d - DEPTH_OFFSET),
+                                      uint8_t(uint8_t(pv) << 2 | b)};
+
+    if (buffer.count == TTBatchSize)
+        flush(buffer);
+}
+
+
+void flush(TTSendBuffer& buffer) {
+
+#ifndef _WIN32
+    if (buffer.count && clusterSize > 1)
+    {
+        TTBatch batch;
+        batch.type  = TT_ENTRIES;
+        batch.rank  = uint8_t(rankIdx);
+        batch.count = uint16_t(buffer.count);
+        std::copy(buffer.entries, buffer.entries + buffer.count, batch.entries);
+
+        send_all(&batch, offsetof(TTBatch, entries) + buffer.count * sizeof(TTMessage), false);
+    }
+#endif
+
+    buffer.count = 0;
+}
+
+
+void apply_received(TranspositionTable& tt) {
+
+#ifndef _WIN32
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        applying.swap(received);
+    }
+
+    for (const TTMessage& e : applying)
+    {
+        bool     found;
+        TTEntry* tte = tt.probe(e.key, found);
+        tte->save(e.key, Value(e.value), e.pvBound & 0x4, Bound(e.pvBound & 0x3),
+                  Depth(e.depth8 + DEPTH_OFFSET), Move(e.move), Value(e.eval), tt.generation());
+    }
+
+    applying.clear();
+#else
+    (void) tt;
+#endif
+}
+
+
+// The searches are numbered by the votes that end them, so the current one is
+// searchCount + 1 on every rank.
+void stop() {
+
+#ifndef _WIN32
+    if (clusterSize == 1 || !is_root())
+        return;
+
+    const StopMessage msg{STOP, uint8_t(rankIdx), searchCount + 1};
+    send_all(&msg, sizeof(msg), true);
+#endif
+}
+
+
+bool stop_requested() {
+
+#ifndef _WIN32
+    return stopId.load(std::memory_order_relaxed) == searchCount + 1;
+#else
+    return false;
+#endif
+}
+
+
+bool vote(std::vector<Move>& pv, Value& score, Depth& depth, bool pick) {
+
+#ifndef _WIN32
+    if (clusterSize == 1)
+        return false;
+
+    ResultMessage local{};
+    local.type     = RESULT;
+    local.rank     = uint8_t(rankIdx);
+    local.pvLength = uint16_t(std::min(pv.size(), MaxVotedPV));
+    local.searchId = ++searchCount;
+    local.score    = int32_t(score);
+    local.depth    = int32_t(depth);
+
+    for (size_t i = 0; i < local.pvLength; ++i)
+        local.pv[i] = pv[i].raw();
+
+    send_all(&local, sizeof(local), true);
+
+    std::vector<ResultMessage> all{local};
+
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+
+        auto current = [&](const ResultMessage& r) { return r.searchId == local.searchId; };
+
+        cv.wait_for(lk, VoteTimeout, [&] {
+            return std::count_if(results.begin(), results.end(), current) >= live_others();
+        });
+
+        std::copy_if(results.begin(), results.end(), std::back_inserter(all), current);
+        results.erase(std::remove_if(results.begin(), results.end(),
+                                     [&](const ResultMessage& r) {
+                                         return r.searchId <= local.searchId;
+                                     }),
+                      results.end());
+    }
+
+    if (!pick)
+        return false;
+
+    // Vote according to score and depth as in ThreadPool::get_best_thread()
+    int32_t minScore = local.score;
+    for (const ResultMessage& r : all)
+        minScore = std::min(minScore, r.score);
+
+    std::unordered_map<uint16_t, int64_t> votes;
+    for (const ResultMessage& r : all)
+        if (r.pvLength)
+            votes[r.pv[0]] += int64_t(r.score - minScore + 14) * r.depth;
+
+    const ResultMessage* best = &all.front();
+    for (const ResultMessage& r : all)
+        if (r.pvLength
+            && (votes[r.pv[0]] > votes[best->pv[0]]
+                || (r.pv[0] == best->pv[0] && r.score > best->score)))
+            best = &r;
+
+    if (!best->pvLength || best->pv[0] == local.pv[0])
+        return false;
+
+    pv.clear();
+    for (size_t i = 0; i < std::min<size_t>(best->pvLength, MaxVotedPV); ++i)
+        pv.emplace_back(best->pv[i]);
+
+    score = Value(best->score);
+    depth = Depth(best->depth);
+    return true;
+#else
+    (void) pv, (void) score, (void) depth, (void) pick;
+    return false;
+#endif
+}
+
+}  // namespace Stockfish::Cluster
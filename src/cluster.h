@@ -0,0 +1,102 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLUSTER_H_INCLUDED
+#define CLUSTER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace Stockfish {
+
+class TranspositionTable;
+
+// Cluster mode runs a search over several engine processes, called ranks, each
+// one with its own thread pool. Rank 0 reads the UCI commands and forwards them
+// to the other ranks, whose output is discarded. During the search the ranks
+// broadcast their deep transposition table entries, and at the end of the
+// search they vote for the best move as the threads of a pool do.
+//
+// Messages are datagrams over Unix domain sockets, so the ranks run on one
+// host. A process is a rank of a cluster of N processes when it is started
+// with SF_CLUSTER_SIZE=N and SF_CLUSTER_RANK=0..N-1 in its environment. The
+// sockets are named SF_CLUSTER_SOCKET.<rank>, /tmp/stockfish-cluster.<rank>
+// by default.
+namespace Cluster {
+
+// Entries saved with at least this depth are sent to the other ranks
+constexpr Depth BroadcastDepth = 10;
+
+constexpr size_t TTBatchSize = 64;
+
+// A transposition table entry as sent to the other ranks. The value is the
+// one stored in the table, that is relative to the position, and the depth is
+// stored as in TTEntry, offset by DEPTH_OFFSET.
+struct TTMessage {
+    Key      key;
+    int16_t  value, eval;
+    uint16_t move;
+    uint8_t  depth8;
+    uint8_t  pvBound;
+};
+
+// Deep entries saved by a search thread, sent in batches
+struct TTSendBuffer {
+    size_t    count = 0;
+    TTMessage entries[TTBatchSize];
+};
+
+void init();
+void finalize();
+int  rank();
+int  size();
+inline bool is_root() { return rank() == 0; }
+
+// Reads the next UCI command: from the standard input on rank 0, which then
+// forwards it to the other ranks, or as forwarded by rank 0 on the others.
+// Returns false at the end of the input.
+bool read_command(std::string& cmd);
+
+void save(TTSendBuffer& buffer, Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev);
+void flush(TTSendBuffer& buffer);
+
+// Saves the entries received from the other ranks, called by the main thread
+// while searching.
+void apply_received(TranspositionTable& tt);
+
+// Rank 0 decides when a search of the cluster ends: once its own search is
+// stopped, stop() tells the other ranks, whose main thread polls
+// stop_requested() and then stops theirs before they vote.
+void stop();
+bool stop_requested();
+
+// Exchanges the result of the search that just finished, its PV, score and
+// depth, with the other ranks and, when pick is set and the cluster votes for
+// another best move, replaces it with the result of that rank. Returns whether
+// it was replaced.
+bool vote(std::vector<Move>& pv, Value& score, Depth& depth, bool pick);
+
+}  // namespace Cluster
+
+}  // namespace Stockfish
+
+#endif  // #ifndef CLUSTER_H_INCLUDED
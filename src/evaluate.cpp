@@ -24,6 +24,7 @@
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 #include "nnue/network.h"
@@ -43,20 +44,25 @@ int Eval::simple_eval(const Position& pos, Color c) {
 }
 
 
-// Evaluate is the evaluator for the outer world. It returns a static evaluation
-// of the position from the point of view of the side to move.
-Value Eval::evaluate(const Eval::NNUE::Networks& networks, const Position& pos, int optimism) {
+namespace {
 
-    // assert(!pos.checkers());
+// Runs the selected network on the position and blends its output with optimism,
+// material and the 50-move rule counter. With psqtOnly set, only the PSQT term of
+// the network is computed and the L1 transform and layer stack are skipped.
+Value evaluate_nnue(const Eval::NNUE::Networks& networks,
+                    Eval::NNUE::EvalWorkspace&  workspace,
+                    const Position&             pos,
+                    int                         optimism,
+                    int                         simpleEval,
+                    bool                        smallNet,
+                    bool                        psqtOnly) {
 
-    int  simpleEval = simple_eval(pos, pos.side_to_move());
-    bool smallNet   = std::abs(simpleEval) > SmallNetThreshold;
-    bool psqtOnly   = std::abs(simpleEval) > PsqtOnlyThreshold;
-    int  nnueComplexity;
-    int  v;
+    int nnueComplexity;
+    int v;
 
-    Value nnue = smallNet ? networks.small.evaluate(pos, true, &nnueComplexity, psqtOnly)
-                          : networks.big.evaluate(pos, true, &nnueComplexity, false);
+    Value nnue =
+      smallNet ? networks.small.evaluate(pos, workspace.small, true, &nnueComplexity, psqtOnly)
+               : networks.big.evaluate(pos, workspace.big, true, &nnueComplexity, psqtOnly);
 
     const auto adjustEval = [&](int optDiv, int nnueDiv, int pawnCountConstant, int pawnCountMul,
                                 int npmConstant, int evalDiv, int shufflingConstant,
@@ -83,9 +89,57 @@ Value Eval::evaluate(const Eval::NNUE::Networks& networks, const Position& pos,
         adjustEval(499, 32793, 903, 9, 147, 1067, 208, 211);
 
     // Guarantee evaluation does not hit the tablebase range
-    v = std::clamp(v, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
+    return std::clamp(v, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
+}
+
+}  // namespace
+
+
+// Evaluate is the evaluator for the outer world. It returns a static evaluation
+// of the position from the point of view of the side to move.
+Value Eval::evaluate(const Eval::NNUE::Networks& networks,
+                     Eval::NNUE::EvalWorkspace&  workspace,
+                     const Position&             pos,
+                     int                         optimism) {
+
+    // assert(!pos.checkers());
+
+    int  simpleEval = simple_eval(pos, pos.side_to_move());
+    bool smallNet   = std::abs(simpleEval) > SmallNetThreshold;
+    bool psqtOnly   = std::abs(simpleEval) > PsqtOnlyThreshold;
 
-    return v;
+    return evaluate_nnue(networks, workspace, pos, optimism, simpleEval, smallNet, psqtOnly);
+}
+
+
+// Staged version of evaluate(). The PSQT term of the selected network, which is
+// kept up to date in psqtAccumulation, is evaluated first. If it is already at
+// least LazyThreshold outside the [alpha, beta] window, it is returned as is and
+// 'lazy' is set, so the caller knows the value is only a coarse estimate. Otherwise
+// the full L1 transform and layer stack are run and the result is exact.
+Value Eval::evaluate(const Eval::NNUE::Networks& networks,
+                     Eval::NNUE::EvalWorkspace&  workspace,
+                     const Position&             pos,
+                     int                         optimism,
+                     Value                       alpha,
+                     Value                       beta,
+                     bool&                       lazy) {
+
+    int  simpleEval = simple_eval(pos, pos.side_to_move());
+    bool smallNet   = std::abs(simpleEval) > SmallNetThreshold;
+    bool psqtOnly   = std::abs(simpleEval) > PsqtOnlyThreshold;
+
+    lazy = false;
+
+    if (!psqtOnly)
+    {
+        Value v = evaluate_nnue(networks, workspace, pos, optimism, simpleEval, smallNet, true);
+
+        if (v >= beta + LazyThreshold || v <= alpha - LazyThreshold)
+            return lazy = true, v;
+    }
+
+    return evaluate_nnue(networks, workspace, pos, optimism, simpleEval, smallNet, psqtOnly);
 }
 
 // Like evaluate(), but instead of returning a value, it returns
@@ -103,11 +157,13 @@ std::string Eval::trace(Position& pos, const Eval::NNUE::Networks& networks) {
 
     ss << std::showpoint << std::showpos << std::fixed << std::setprecision(2) << std::setw(15);
 
-    Value v = networks.big.evaluate(pos, false);
+    auto workspace = std::make_unique<NNUE::EvalWorkspace>();
+
+    Value v = networks.big.evaluate(pos, workspace->big, false);
     v       = pos.side_to_move() == WHITE ? v : -v;
     ss << "NNUE evaluation        " << 0.01 * UCI::to_cp(v, pos) << " (white side)\n";
 
-    v = evaluate(networks, pos, VALUE_ZERO);
+    v = evaluate(networks, *workspace, pos, VALUE_ZERO);
     v = pos.side_to_move() == WHITE ? v : -v;
     ss << "Final evaluation       " << 0.01 * UCI::to_cp(v, pos) << " (white side)";
     ss << " [with scaled NNUE, ...]";
@@ -29,7 +29,7 @@ class Position;
 
 namespace Eval {
 
-constexpr inline int SmallNetThreshold = 1165, PsqtOnlyThreshold = 2500;
+constexpr inline int SmallNetThreshold = 1165, PsqtOnlyThreshold = 2500, LazyThreshold = 1400;
 
 // The default net name MUST follow the format nn-[SHA256 first 12 digits].nnue
 // for the build process (profile-build and fishtest) to work. Do not change the
@@ -40,12 +40,23 @@ constexpr inline int SmallNetThreshold = 1165, PsqtOnlyThreshold = 2500;
 
 namespace NNUE {
 struct Networks;
+struct EvalWorkspace;
 }
 
 std::string trace(Position& pos, const Eval::NNUE::Networks& networks);
 
 int   simple_eval(const Position& pos, Color c);
-Value evaluate(const NNUE::Networks& networks, const Position& pos, int optimism);
+Value evaluate(const NNUE::Networks& networks,
+               NNUE::EvalWorkspace&  workspace,
+               const Position&       pos,
+               int                   optimism);
+Value evaluate(const NNUE::Networks& networks,
+               NNUE::EvalWorkspace&  workspace,
+               const Position&       pos,
+               int                   optimism,
+               Value                 alpha,
+               Value                 beta,
+               bool&                 lazy);
 
 
 }  // namespace Eval
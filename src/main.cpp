@@ -19,6 +19,7 @@
 #include <iostream>
 
 #include "bitboard.h"
+#include "cluster.h"
 #include "misc.h"
 #include "position.h"
 #include "tune.h"
@@ -29,6 +30,8 @@ using namespace Stockfish;
 
 int main(int argc, char* argv[]) {
 
+    Cluster::init();
+
     std::cout << engine_info() << std::endl;
 
     Bitboards::init();
@@ -40,5 +43,7 @@ int main(int argc, char* argv[]) {
 
     uci.loop();
 
+    Cluster::finalize();
+
     return 0;
 }
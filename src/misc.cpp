@@ -47,15 +47,27 @@ using fun8_t = bool (*)(HANDLE, BOOL, PTOKEN_PRIVILEGES, DWORD, PTOKEN_PRIVILEGE
 }
 #endif
 
+#if defined(__linux__) && !defined(__ANDROID__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#include <algorithm>
 #include <atomic>
 #include <cmath>
+#include <condition_variable>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <mutex>
 #include <sstream>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include "types.h"
 
@@ -393,17 +405,152 @@ void dbg_print() {
 }
 
 
+namespace {
+
+// Serializes the access to std::cout of sync_cout and of the output writer
+std::mutex ioMutex;
+
+// A bounded multi-producer, single-consumer queue in the style of D. Vyukov.
+// Each slot has a sequence number telling whether it is free for the producer
+// holding ticket 'seq' or filled for the consumer reading at 'seq - 1', so
+// producers only contend on the ticket counter. When the ring is full the
+// producers yield until the writer makes room.
+class OutputRing {
+
+    static constexpr size_t Size        = 256;
+    static constexpr int    SpinRetries = 64;
+
+    struct Slot {
+        std::atomic<size_t> seq;
+        std::string         text;
+    };
+
+   public:
+    OutputRing() {
+        for (size_t i = 0; i < Size; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // Write what is left and stop the writer at exit
+    ~OutputRing() {
+        if (!writer.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            exit = true;
+        }
+        cv.notify_one();
+        writer.join();
+    }
+
+    void push(std::string& text) {
+
+        std::call_once(started, [this]() { writer = std::thread(&OutputRing::write_loop, this); });
+
+        size_t ticket = tail.fetch_add(1, std::memory_order_relaxed);
+        Slot&  slot   = slots[ticket % Size];
+
+        while (slot.seq.load(std::memory_order_acquire) != ticket)
+            std::this_thread::yield();
+
+        std::swap(slot.text, text);
+        text.clear();
+        slot.seq.store(ticket + 1);
+
+        // Take the mutex only to wake up an idle writer
+        if (sleeping.load())
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            cv.notify_one();
+        }
+    }
+
+    // Wait until the text queued so far has been written
+    void flush() const {
+        size_t target = tail.load(std::memory_order_relaxed);
+
+        while (head.load(std::memory_order_acquire) < target)
+            std::this_thread::yield();
+    }
+
+   private:
+    bool ready(size_t pos) const { return slots[pos % Size].seq.load() == pos + 1; }
+
+    void write_loop() {
+
+        size_t pos = 0;
+
+        while (true)
+        {
+            // Write out everything available under a single lock and flush
+            if (ready(pos))
+            {
+                std::lock_guard<std::mutex> lk(ioMutex);
+
+                for (; ready(pos); ++pos)
+                {
+                    Slot& slot = slots[pos % Size];
+                    std::cout.write(slot.text.data(), std::streamsize(slot.text.size()));
+                    slot.seq.store(pos + Size, std::memory_order_release);
+                }
+
+                std::cout.flush();
+                head.store(pos, std::memory_order_release);
+                continue;
+            }
+
+            int spins = SpinRetries;
+            while (spins-- && !ready(pos))
+                std::this_thread::yield();
+
+            if (ready(pos))
+                continue;
+
+            std::unique_lock<std::mutex> lk(mutex);
+            sleeping = true;
+            cv.wait(lk, [&] { return exit || ready(pos); });
+            sleeping = false;
+
+            if (exit && !ready(pos))
+                break;
+        }
+    }
+
+    Slot slots[Size];
+
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> head{0};
+    std::atomic_bool                sleeping{false};
+    bool                            exit = false;
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::once_flag          started;
+    std::thread             writer;
+};
+
+OutputRing outputRing;
+
+}  // namespace
+
+void async_cout(std::string& text) { outputRing.push(text); }
+
+void async_flush() { outputRing.flush(); }
+
+
 // Used to serialize access to std::cout
 // to avoid multiple threads writing at the same time.
 std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 
-    static std::mutex m;
-
     if (sc == IO_LOCK)
-        m.lock();
+    {
+        async_flush();
+        ioMutex.lock();
+    }
 
     if (sc == IO_UNLOCK)
-        m.unlock();
+        ioMutex.unlock();
 
     return os;
 }
@@ -715,6 +862,178 @@ void bind_this_thread(size_t idx) {
 
 }  // namespace WinProcGroup
 
+namespace Affinity {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+struct LogicalCpu {
+    int id, node, package, core, smt;
+};
+
+std::string read_sysfs(const std::string& path) {
+
+    std::ifstream file(path);
+    std::string   line;
+    std::getline(file, line);
+    return line;
+}
+
+// Parses a sysfs CPU or node list such as "0-3,8-11"
+std::vector<int> parse_list(const std::string& list) {
+
+    std::vector<int>   ids;
+    std::istringstream is(list);
+    std::string        range;
+
+    while (std::getline(is, range, ','))
+    {
+        auto dash = range.find('-');
+        int  from = std::atoi(range.c_str());
+        int  to   = dash == std::string::npos ? from : std::atoi(range.c_str() + dash + 1);
+
+        for (int id = from; id <= to; ++id)
+            ids.push_back(id);
+    }
+
+    return ids;
+}
+
+// Reads the NUMA node, package and core of each online logical CPU the process
+// is allowed to run on. SMT siblings share package and core and are numbered in
+// order of their CPU id.
+std::vector<LogicalCpu> read_topology() {
+
+    const std::string cpuDir  = "/sys/devices/system/cpu/";
+    const std::string numaDir = "/sys/devices/system/node/";
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed))
+        return {};
+
+    std::vector<int> nodeOf(CPU_SETSIZE, 0);
+    for (int node : parse_list(read_sysfs(numaDir + "online")))
+    {
+        const std::string cpulist = numaDir + "node" + std::to_string(node) + "/cpulist";
+        for (int cpu : parse_list(read_sysfs(cpulist)))
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                nodeOf[cpu] = node;
+    }
+
+    std::vector<LogicalCpu> cpus;
+    for (int cpu : parse_list(read_sysfs(cpuDir + "online")))
+    {
+        if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+            continue;
+
+        const std::string topology = cpuDir + "cpu" + std::to_string(cpu) + "/topology/";
+
+        LogicalCpu c;
+        c.id      = cpu;
+        c.node    = nodeOf[cpu];
+        c.package = std::atoi(read_sysfs(topology + "physical_package_id").c_str());
+        c.core    = std::atoi(read_sysfs(topology + "core_id").c_str());
+        c.smt     = 0;
+
+        for (const auto& other : cpus)
+            c.smt += other.package == c.package && other.core == c.core;
+
+        cpus.push_back(c);
+    }
+
+    return cpus;
+}
+
+// Returns the logical CPUs in the order search threads are assigned to them
+std::vector<int> layout_order(std::vector<LogicalCpu> cpus, const std::string& layout) {
+
+    auto key = [](const LogicalCpu& c) {
+        return std::make_tuple(c.node, c.package, c.core, c.smt);
+    };
+
+    if (layout == "compact")
+        std::sort(cpus.begin(), cpus.end(),
+                  [&](const LogicalCpu& a, const LogicalCpu& b) { return key(a) < key(b); });
+    else
+    {
+        // Siblings come last: all first hardware threads of the physical cores,
+        // then all second ones, and so on.
+        std::sort(cpus.begin(), cpus.end(), [&](const LogicalCpu& a, const LogicalCpu& b) {
+            return std::make_pair(a.smt, key(a)) < std::make_pair(b.smt, key(b));
+        });
+
+        // For spread, deal the cores of each SMT level round-robin over the nodes
+        if (layout == "spread")
+        {
+            std::map<std::pair<int, int>, int>             dealt;  // (smt, node) -> count
+            std::vector<std::tuple<int, int, int, size_t>> deal;   // (smt, round, node, index)
+
+            for (size_t i = 0; i < cpus.size(); ++i)
+                deal.emplace_back(cpus[i].smt, dealt[{cpus[i].smt, cpus[i].node}]++,
+                                  cpus[i].node, i);
+
+            std::sort(deal.begin(), deal.end());
+
+            std::vector<LogicalCpu> spread;
+            for (const auto& d : deal)
+                spread.push_back(cpus[std::get<3>(d)]);
+
+            cpus = spread;
+        }
+    }
+
+    std::vector<int> order;
+    for (const auto& c : cpus)
+        order.push_back(c.id);
+
+    return order;
+}
+
+}  // namespace
+
+#endif
+
+void bind_this_thread(size_t idx, size_t nthreads, const std::string& layout) {
+
+    if (layout == "none")
+        return;
+
+    if (layout == "auto")
+    {
+        // If OS already scheduled us on a different group than 0 then don't overwrite
+        // the choice, eventually we are one of many one-threaded processes running on
+        // some Windows NUMA hardware, for instance in fishtest. To make it simple,
+        // just check if running threads are below a threshold, in this case, all this
+        // NUMA machinery is not needed.
+        if (nthreads > 8)
+            WinProcGroup::bind_this_thread(idx);
+        return;
+    }
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+    // The topology is read once, by the first thread to get here, before any
+    // thread has been pinned, so the allowed mask is still the process one.
+    static const std::vector<LogicalCpu> topology = read_topology();
+
+    const std::vector<int> order = layout_order(topology, layout);
+
+    // With more threads than logical CPUs the remaining ones are left to the OS
+    if (idx >= order.size())
+        return;
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(order[idx], &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+
+#endif
+}
+
+}  // namespace Affinity
+
 #ifdef _WIN32
     #include <direct.h>
     #define GETCWD _getcwd
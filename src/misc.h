@@ -98,6 +98,14 @@ std::ostream& operator<<(std::ostream&, SyncCout);
 #define sync_cout std::cout << IO_LOCK
 #define sync_endl std::endl << IO_UNLOCK
 
+// The search hands its output to a writer thread through a lock-free ring
+// buffer, so that a slow console or pipe never stalls the search. The text,
+// newline included, is swapped with the string of a free slot: the caller gets
+// back a used buffer of the same kind and once the ring is warm no allocation
+// happens. Anything printed with sync_cout waits for the queued text first.
+void async_cout(std::string& text);
+void async_flush();
+
 
 // Get the first aligned element of an array.
 // ptr must point to an array of size at least `sizeof(T) * N + alignment` bytes,
@@ -203,6 +211,18 @@ namespace WinProcGroup {
 void bind_this_thread(size_t idx);
 }
 
+// Places the calling search thread, the idx-th of nthreads, according to the
+// "Thread Binding" option. With "auto" the default placement is kept (processor
+// groups on Windows when there are more than 8 threads) and with "none" it is
+// left entirely to the OS. On Linux, "compact", "spread" and "nosmt" pin each
+// thread to one logical CPU picked from the topology found in sysfs: compact
+// fills SMT siblings and cores of a node before moving to the next node, spread
+// deals physical cores round-robin over the NUMA nodes, and nosmt fills every
+// physical core of every node before using any SMT sibling.
+namespace Affinity {
+void bind_this_thread(size_t idx, size_t nthreads, const std::string& layout);
+}
+
 
 struct CommandLine {
    public:
@@ -26,6 +26,10 @@
 #include <cstdint>
 #include <iostream>
 
+#if defined(NNUE_SPARSE_STATS)
+    #include <atomic>
+#endif
+
 #include "../../bitboard.h"
 #include "../nnue_common.h"
 #include "affine_transform.h"
@@ -128,8 +132,11 @@ void find_nnz(const std::int32_t* input, std::uint16_t* out, IndexType& count_ou
     #undef vec128_add
 #endif
 
-// Sparse input implementation
-template<IndexType InDims, IndexType OutDims>
+// Sparse input implementation. DenseThreshold is the percentage of nonzero
+// 32-bit input blocks at or above which the dense kernel is used instead of
+// walking the nonzero index list: 100 keeps the layer always sparse, 0 makes
+// it always dense and skips the nonzero scan altogether.
+template<IndexType InDims, IndexType OutDims, IndexType DenseThreshold = 100>
 class AffineTransformSparseInput {
    public:
     // Input/output type
@@ -142,6 +149,7 @@ class AffineTransformSparseInput {
 
     static_assert(OutputDimensions % 16 == 0,
                   "Only implemented for OutputDimensions divisible by 16.");
+    static_assert(DenseThreshold <= 100, "DenseThreshold is a percentage.");
 
     static constexpr IndexType PaddedInputDimensions =
       ceil_to_multiple<IndexType>(InputDimensions, MaxSimdWidth);
@@ -236,22 +244,46 @@ class AffineTransformSparseInput {
         const auto input32 = reinterpret_cast<const std::int32_t*>(input);
 
         // Find indices of nonzero 32-bit blocks
-        find_nnz<NumChunks>(input32, nnz, count);
+        if constexpr (DenseThreshold > 0)
+            find_nnz<NumChunks>(input32, nnz, count);
+        else
+            count = NumChunks;
+
+    #if defined(NNUE_SPARSE_STATS)
+        if constexpr (DenseThreshold == 0)
+            count = IndexType(std::count_if(input32, input32 + NumChunks,
+                                            [](std::int32_t v) { return v != 0; }));
+        record_density(count, NumChunks);
+    #endif
 
         const outvec_t* biasvec = reinterpret_cast<const outvec_t*>(biases);
         outvec_t        acc[NumRegs];
         for (IndexType k = 0; k < NumRegs; ++k)
             acc[k] = biasvec[k];
 
-        for (IndexType j = 0; j < count; ++j)
+        if (DenseThreshold == 0 || count * 100 >= NumChunks * DenseThreshold)
         {
-            const auto    i  = nnz[j];
-            const invec_t in = vec_set_32(input32[i]);
-            const auto    col =
-              reinterpret_cast<const invec_t*>(&weights[i * OutputDimensions * ChunkSize]);
-            for (IndexType k = 0; k < NumRegs; ++k)
-                vec_add_dpbusd_32(acc[k], in, col[k]);
+            // Dense input: stream over every block, zero blocks contribute
+            // nothing but avoid the indirection through the index list.
+            for (IndexType i = 0; i < NumChunks; ++i)
+            {
+                const invec_t in = vec_set_32(input32[i]);
+                const auto    col =
+                  reinterpret_cast<const invec_t*>(&weights[i * OutputDimensions * ChunkSize]);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    vec_add_dpbusd_32(acc[k], in, col[k]);
+            }
         }
+        else
+            for (IndexType j = 0; j < count; ++j)
+            {
+                const auto    i  = nnz[j];
+                const invec_t in = vec_set_32(input32[i]);
+                const auto    col =
+                  reinterpret_cast<const invec_t*>(&weights[i * OutputDimensions * ChunkSize]);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    vec_add_dpbusd_32(acc[k], in, col[k]);
+            }
 
         outvec_t* outptr = reinterpret_cast<outvec_t*>(output);
         for (IndexType k = 0; k < NumRegs; ++k)
@@ -259,13 +291,42 @@ class AffineTransformSparseInput {
     #undef vec_set_32
     #undef vec_add_dpbusd_32
 #else
+    #if defined(NNUE_SPARSE_STATS)
+        constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 4) / 4;
+        const auto          input32   = reinterpret_cast<const std::int32_t*>(input);
+        record_density(IndexType(std::count_if(input32, input32 + NumChunks,
+                                               [](std::int32_t v) { return v != 0; })),
+                       NumChunks);
+    #endif
         // Use dense implementation for the other architectures.
         affine_transform_non_ssse3<InputDimensions, PaddedInputDimensions, OutputDimensions>(
           output, weights, biases, input);
 #endif
     }
 
+#if defined(NNUE_SPARSE_STATS)
+    // Histogram of the fraction of nonzero 32-bit input blocks seen by
+    // propagate(), bin i counting densities in [i, i + 1) / DensityBins.
+    static constexpr IndexType DensityBins = 10;
+
+    std::array<std::uint64_t, DensityBins> density_histogram() const {
+        std::array<std::uint64_t, DensityBins> h;
+        for (IndexType i = 0; i < DensityBins; ++i)
+            h[i] = densityHistogram[i].load(std::memory_order_relaxed);
+        return h;
+    }
+#endif
+
    private:
+#if defined(NNUE_SPARSE_STATS)
+    void record_density(IndexType count, IndexType numChunks) const {
+        const IndexType bin = std::min(count * DensityBins / numChunks, DensityBins - 1);
+        densityHistogram[bin].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    mutable std::atomic<std::uint64_t> densityHistogram[DensityBins];
+#endif
+
     using BiasType   = OutputType;
     using WeightType = std::int8_t;
 
@@ -18,11 +18,15 @@
 
 #include "network.h"
 
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <optional>
 #include <type_traits>
 #include <vector>
@@ -89,8 +93,9 @@ namespace Detail {
 template<typename T>
 void initialize(AlignedPtr<T>& pointer) {
 
-    pointer.reset(reinterpret_cast<T*>(std_aligned_alloc(alignof(T), sizeof(T))));
-    std::memset(pointer.get(), 0, sizeof(T));
+    // Value-initialization zeroes the parameters as a memset would, and also
+    // constructs the density counters of a -DNNUE_SPARSE_STATS build.
+    pointer.reset(new (std_aligned_alloc(alignof(T), sizeof(T))) T());
 }
 
 template<typename T>
@@ -187,31 +192,19 @@ bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename
 
 template<typename Arch, typename Transformer>
 Value Network<Arch, Transformer>::evaluate(const Position& pos,
+                                           Workspace&      workspace,
                                            bool            adjusted,
                                            int*            complexity,
                                            bool            psqtOnly) const {
-    // We manually align the arrays on the stack because with gcc < 9.3
-    // overaligning stack variables with alignas() doesn't work correctly.
-
-    constexpr uint64_t alignment = CacheLineSize;
-    constexpr int      delta     = 24;
-
-#if defined(ALIGNAS_ON_STACK_VARIABLES_BROKEN)
-    TransformedFeatureType transformedFeaturesUnaligned
-      [FeatureTransformer<Arch::TransformedFeatureDimensions, nullptr>::BufferSize
-       + alignment / sizeof(TransformedFeatureType)];
+    constexpr int delta = 24;
 
-    auto* transformedFeatures = align_ptr_up<alignment>(&transformedFeaturesUnaligned[0]);
-#else
-    alignas(alignment) TransformedFeatureType transformedFeatures
-      [FeatureTransformer<Arch::TransformedFeatureDimensions, nullptr>::BufferSize];
-#endif
-
-    ASSERT_ALIGNED(transformedFeatures, alignment);
+    ASSERT_ALIGNED(workspace.transformedFeatures, CacheLineSize);
 
     const int  bucket = (pos.count<ALL_PIECES>() - 1) / 4;
-    const auto psqt   = featureTransformer->transform(pos, transformedFeatures, bucket, psqtOnly);
-    const auto positional = !psqtOnly ? (network[bucket]->propagate(transformedFeatures)) : 0;
+    const auto psqt =
+      featureTransformer->transform(pos, workspace.transformedFeatures, bucket, psqtOnly);
+    const auto positional =
+      !psqtOnly ? network[bucket]->propagate(workspace.transformedFeatures, workspace.buffer) : 0;
 
     if (complexity)
         *complexity = !psqtOnly ? std::abs(psqt - positional) / OutputScale : 0;
@@ -225,6 +218,37 @@ Value Network<Arch, Transformer>::evaluate(const Position& pos,
 }
 
 
+template<typename Arch, typename Transformer>
+Value Network<Arch, Transformer>::profile_evaluate(const Position&  pos,
+                                                   Workspace&       workspace,
+                                                   NnueEvalProfile& profile) const {
+    using Clock = std::chrono::steady_clock;
+
+    auto elapsed = [](Clock::time_point from, Clock::time_point to) {
+        return std::uint64_t(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    };
+
+    const int bucket = (pos.count<ALL_PIECES>() - 1) / 4;
+
+    const auto t0 = Clock::now();
+    const auto psqt =
+      featureTransformer->transform(pos, workspace.transformedFeatures, bucket, false);
+    const auto t1 = Clock::now();
+    network[bucket]->propagate_sparse(workspace.transformedFeatures, workspace.buffer);
+    const auto t2         = Clock::now();
+    const auto positional = network[bucket]->propagate_dense(workspace.buffer);
+    const auto t3         = Clock::now();
+
+    profile.evals++;
+    profile.transform += elapsed(t0, t1);
+    profile.sparse += elapsed(t1, t2);
+    profile.dense += elapsed(t2, t3);
+
+    return static_cast<Value>((psqt + positional) / OutputScale);
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::verify(std::string evalfilePath) const {
     if (evalfilePath.empty())
@@ -262,30 +286,16 @@ void Network<Arch, Transformer>::hint_common_access(const Position& pos, bool ps
 
 template<typename Arch, typename Transformer>
 NnueEvalTrace Network<Arch, Transformer>::trace_evaluate(const Position& pos) const {
-    // We manually align the arrays on the stack because with gcc < 9.3
-    // overaligning stack variables with alignas() doesn't work correctly.
-    constexpr uint64_t alignment = CacheLineSize;
-
-#if defined(ALIGNAS_ON_STACK_VARIABLES_BROKEN)
-    TransformedFeatureType transformedFeaturesUnaligned
-      [FeatureTransformer<Arch::TransformedFeatureDimensions, nullptr>::BufferSize
-       + alignment / sizeof(TransformedFeatureType)];
-
-    auto* transformedFeatures = align_ptr_up<alignment>(&transformedFeaturesUnaligned[0]);
-#else
-    alignas(alignment) TransformedFeatureType transformedFeatures
-      [FeatureTransformer<Arch::TransformedFeatureDimensions, nullptr>::BufferSize];
-#endif
-
-    ASSERT_ALIGNED(transformedFeatures, alignment);
+    auto workspace = std::make_unique<Workspace>();
 
     NnueEvalTrace t{};
     t.correctBucket = (pos.count<ALL_PIECES>() - 1) / 4;
     for (IndexType bucket = 0; bucket < LayerStacks; ++bucket)
     {
         const auto materialist =
-          featureTransformer->transform(pos, transformedFeatures, bucket, false);
-        const auto positional = network[bucket]->propagate(transformedFeatures);
+          featureTransformer->transform(pos, workspace->transformedFeatures, bucket, false);
+        const auto positional =
+          network[bucket]->propagate(workspace->transformedFeatures, workspace->buffer);
 
         t.psqt[bucket]       = static_cast<Value>(materialist / OutputScale);
         t.positional[bucket] = static_cast<Value>(positional / OutputScale);
@@ -295,6 +305,41 @@ NnueEvalTrace Network<Arch, Transformer>::trace_evaluate(const Position& pos) co
 }
 
 
+template<typename Arch, typename Transformer>
+void Network<Arch, Transformer>::sparse_input_stats(std::ostream& os) const {
+#if defined(NNUE_SPARSE_STATS)
+    using FC0 = decltype(Arch::fc_0);
+
+    os << "\nSparse input density of fc_0 (" << Arch::TransformedFeatureDimensions
+       << " inputs, " << (embeddedType == EmbeddedNNUEType::BIG ? "big" : "small")
+       << " net), % of calls per density bin\n"
+       << "bucket      calls   avg%";
+    for (IndexType i = 0; i < FC0::DensityBins; ++i)
+        os << std::setw(6) << (i * 100 / FC0::DensityBins) << '+';
+    os << '\n';
+
+    for (IndexType bucket = 0; bucket < LayerStacks; ++bucket)
+    {
+        const auto    h     = network[bucket]->fc_0.density_histogram();
+        std::uint64_t calls = 0, weighted = 0;
+        for (IndexType i = 0; i < FC0::DensityBins; ++i)
+        {
+            calls += h[i];
+            weighted += h[i] * (2 * i + 1);
+        }
+
+        os << std::setw(6) << bucket << std::setw(11) << calls << std::setw(7)
+           << (calls ? weighted * 50 / FC0::DensityBins / calls : 0);
+        for (IndexType i = 0; i < FC0::DensityBins; ++i)
+            os << std::setw(7) << (calls ? h[i] * 100 / calls : 0);
+        os << '\n';
+    }
+#else
+    (void) os;
+#endif
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::load_user_net(const std::string& dir,
                                                const std::string& evalfilePath) {
@@ -432,11 +477,11 @@ bool Network<Arch, Transformer>::write_parameters(std::ostream&      stream,
 // Explicit template instantiation
 
 template class Network<
-  NetworkArchitecture<TransformedFeatureDimensionsBig, L2Big, L3Big>,
+  NetworkArchitecture<TransformedFeatureDimensionsBig, L2Big, L3Big, DenseThresholdBig>,
   FeatureTransformer<TransformedFeatureDimensionsBig, &StateInfo::accumulatorBig>>;
 
 template class Network<
-  NetworkArchitecture<TransformedFeatureDimensionsSmall, L2Small, L3Small>,
+  NetworkArchitecture<TransformedFeatureDimensionsSmall, L2Small, L3Small, DenseThresholdSmall>,
   FeatureTransformer<TransformedFeatureDimensionsSmall, &StateInfo::accumulatorSmall>>;
 
 }  // namespace Stockfish::Eval::NNUE
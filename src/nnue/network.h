@@ -44,6 +44,13 @@ enum class EmbeddedNNUEType {
 template<typename Arch, typename Transformer>
 class Network {
    public:
+    // Scratch memory for one evaluation: the output of the feature transformer
+    // and the buffers between the layers of the layer stack.
+    struct alignas(CacheLineSize) Workspace {
+        alignas(CacheLineSize) TransformedFeatureType transformedFeatures[Transformer::BufferSize];
+        typename Arch::Buffer buffer;
+    };
+
     Network(EvalFile file, EmbeddedNNUEType type) :
         evalFile(file),
         embeddedType(type) {}
@@ -53,16 +60,26 @@ class Network {
 
 
     Value evaluate(const Position& pos,
+                   Workspace&      workspace,
                    bool            adjusted   = false,
                    int*            complexity = nullptr,
                    bool            psqtOnly   = false) const;
 
 
+    // Same as evaluate(), but accumulates the time spent in the feature
+    // transformer, the sparse first layer and the dense layers into profile.
+    Value
+    profile_evaluate(const Position& pos, Workspace& workspace, NnueEvalProfile& profile) const;
+
     void hint_common_access(const Position& pos, bool psqtOnl) const;
 
     void          verify(std::string evalfilePath) const;
     NnueEvalTrace trace_evaluate(const Position& pos) const;
 
+    // Prints the per-bucket input density histogram of the first layer,
+    // only available in builds with -DNNUE_SPARSE_STATS.
+    void sparse_input_stats(std::ostream& os) const;
+
    private:
     void load_user_net(const std::string&, const std::string&);
     void load_internal();
@@ -95,16 +112,25 @@ class Network {
 using SmallFeatureTransformer =
   FeatureTransformer<TransformedFeatureDimensionsSmall, &StateInfo::accumulatorSmall>;
 using SmallNetworkArchitecture =
-  NetworkArchitecture<TransformedFeatureDimensionsSmall, L2Small, L3Small>;
+  NetworkArchitecture<TransformedFeatureDimensionsSmall, L2Small, L3Small, DenseThresholdSmall>;
 
 using BigFeatureTransformer =
   FeatureTransformer<TransformedFeatureDimensionsBig, &StateInfo::accumulatorBig>;
-using BigNetworkArchitecture = NetworkArchitecture<TransformedFeatureDimensionsBig, L2Big, L3Big>;
+using BigNetworkArchitecture =
+  NetworkArchitecture<TransformedFeatureDimensionsBig, L2Big, L3Big, DenseThresholdBig>;
 
 using NetworkBig   = Network<BigNetworkArchitecture, BigFeatureTransformer>;
 using NetworkSmall = Network<SmallNetworkArchitecture, SmallFeatureTransformer>;
 
 
+// Evaluation scratch memory for both networks. Each search thread owns one,
+// allocated by the thread itself so that it lives on the thread's memory node.
+struct EvalWorkspace {
+    NetworkBig::Workspace   big;
+    NetworkSmall::Workspace small;
+};
+
+
 struct Networks {
     Networks(NetworkBig&& nB, NetworkSmall&& nS) :
         big(std::move(nB)),
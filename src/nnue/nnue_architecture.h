@@ -46,16 +46,22 @@ constexpr IndexType TransformedFeatureDimensionsSmall = 128;
 constexpr int       L2Small                           = 15;
 constexpr int       L3Small                           = 32;
 
+// Input density (in percent of nonzero 32-bit blocks) from which the first
+// layer switches to its dense kernel, see AffineTransformSparseInput. A build
+// with -DNNUE_SPARSE_STATS reports the measured densities at the end of bench.
+constexpr IndexType DenseThresholdBig   = 100;
+constexpr IndexType DenseThresholdSmall = 100;
+
 constexpr IndexType PSQTBuckets = 8;
 constexpr IndexType LayerStacks = 8;
 
-template<IndexType L1, int L2, int L3>
+template<IndexType L1, int L2, int L3, IndexType DenseThreshold = 100>
 struct NetworkArchitecture {
     static constexpr IndexType TransformedFeatureDimensions = L1;
     static constexpr int       FC_0_OUTPUTS                 = L2;
     static constexpr int       FC_1_OUTPUTS                 = L3;
 
-    Layers::AffineTransformSparseInput<TransformedFeatureDimensions, FC_0_OUTPUTS + 1> fc_0;
+    Layers::AffineTransformSparseInput<L1, FC_0_OUTPUTS + 1, DenseThreshold>           fc_0;
     Layers::SqrClippedReLU<FC_0_OUTPUTS + 1>                                           ac_sqr_0;
     Layers::ClippedReLU<FC_0_OUTPUTS + 1>                                              ac_0;
     Layers::AffineTransform<FC_0_OUTPUTS * 2, FC_1_OUTPUTS>                            fc_1;
@@ -91,29 +97,30 @@ struct NetworkArchitecture {
             && fc_2.write_parameters(stream);
     }
 
-    std::int32_t propagate(const TransformedFeatureType* transformedFeatures) {
-        struct alignas(CacheLineSize) Buffer {
-            alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
-            alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
-              ac_sqr_0_out[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2, 32)];
-            alignas(CacheLineSize) typename decltype(ac_0)::OutputBuffer ac_0_out;
-            alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
-            alignas(CacheLineSize) typename decltype(ac_1)::OutputBuffer ac_1_out;
-            alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
-
-            Buffer() { std::memset(this, 0, sizeof(*this)); }
-        };
-
-#if defined(__clang__) && (__APPLE__)
-        // workaround for a bug reported with xcode 12
-        static thread_local auto tlsBuffer = std::make_unique<Buffer>();
-        // Access TLS only once, cache result.
-        Buffer& buffer = *tlsBuffer;
-#else
-        alignas(CacheLineSize) static thread_local Buffer buffer;
-#endif
+    struct alignas(CacheLineSize) Buffer {
+        alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
+        alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
+          ac_sqr_0_out[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2, 32)];
+        alignas(CacheLineSize) typename decltype(ac_0)::OutputBuffer ac_0_out;
+        alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
+        alignas(CacheLineSize) typename decltype(ac_1)::OutputBuffer ac_1_out;
+        alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
+
+        Buffer() { std::memset(this, 0, sizeof(*this)); }
+    };
+
+    std::int32_t propagate(const TransformedFeatureType* transformedFeatures, Buffer& buffer) {
+        propagate_sparse(transformedFeatures, buffer);
+        return propagate_dense(buffer);
+    }
 
+    // First layer, fed by the sparse output of the feature transformer
+    void propagate_sparse(const TransformedFeatureType* transformedFeatures, Buffer& buffer) {
         fc_0.propagate(transformedFeatures, buffer.fc_0_out);
+    }
+
+    // Remaining dense layers, starting from the output of fc_0
+    std::int32_t propagate_dense(Buffer& buffer) {
         ac_sqr_0.propagate(buffer.fc_0_out, buffer.ac_sqr_0_out);
         ac_0.propagate(buffer.fc_0_out, buffer.ac_0_out);
         std::memcpy(buffer.ac_sqr_0_out + FC_0_OUTPUTS, buffer.ac_0_out,
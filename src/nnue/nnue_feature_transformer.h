@@ -321,6 +321,57 @@ class FeatureTransformer {
     }
 
    private:
+#ifdef VECTOR
+    // Applies the removed and added rows of one state to the register resident
+    // accumulator tile starting at offset. For the usual move shapes (quiet
+    // move or promotion, capture or en passant) the rows are combined first,
+    // so each register of the tile receives a single add per state and the
+    // row loads do not depend on the running accumulator.
+    void apply_row_changes(vec_t (&acc)[NumRegs],
+                           const FeatureSet::IndexList& removed,
+                           const FeatureSet::IndexList& added,
+                           IndexType                    offset) const {
+        auto column = [&](IndexType index) {
+            return reinterpret_cast<const vec_t*>(&weights[HalfDimensions * index + offset]);
+        };
+
+        if (removed.size() == 1 && added.size() == 1)
+        {
+            const vec_t* columnR0 = column(removed[0]);
+            const vec_t* columnA  = column(added[0]);
+            for (IndexType k = 0; k < NumRegs; ++k)
+                acc[k] = vec_add_16(acc[k], vec_sub_16(columnA[k], columnR0[k]));
+        }
+        else if (removed.size() == 2 && added.size() == 1)
+        {
+            const vec_t* columnR0 = column(removed[0]);
+            const vec_t* columnR1 = column(removed[1]);
+            const vec_t* columnA  = column(added[0]);
+            for (IndexType k = 0; k < NumRegs; ++k)
+                acc[k] = vec_add_16(acc[k], vec_sub_16(columnA[k],
+                                                       vec_add_16(columnR0[k], columnR1[k])));
+        }
+        else
+        {
+            // Difference calculation for the deactivated features
+            for (const auto index : removed)
+            {
+                const vec_t* columnR = column(index);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    acc[k] = vec_sub_16(acc[k], columnR[k]);
+            }
+
+            // Difference calculation for the activated features
+            for (const auto index : added)
+            {
+                const vec_t* columnA = column(index);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    acc[k] = vec_add_16(acc[k], columnA[k]);
+            }
+        }
+    }
+#endif
+
     template<Color Perspective>
     [[nodiscard]] std::pair<StateInfo*, StateInfo*>
     try_find_computed_accumulator(const Position& pos, bool psqtOnly) const {
@@ -482,23 +533,7 @@ class FeatureTransformer {
 
                     for (IndexType i = 0; states_to_update[i]; ++i)
                     {
-                        // Difference calculation for the deactivated features
-                        for (const auto index : removed[i])
-                        {
-                            const IndexType offset = HalfDimensions * index + j * TileHeight;
-                            auto column = reinterpret_cast<const vec_t*>(&weights[offset]);
-                            for (IndexType k = 0; k < NumRegs; ++k)
-                                acc[k] = vec_sub_16(acc[k], column[k]);
-                        }
-
-                        // Difference calculation for the activated features
-                        for (const auto index : added[i])
-                        {
-                            const IndexType offset = HalfDimensions * index + j * TileHeight;
-                            auto column = reinterpret_cast<const vec_t*>(&weights[offset]);
-                            for (IndexType k = 0; k < NumRegs; ++k)
-                                acc[k] = vec_add_16(acc[k], column[k]);
-                        }
+                        apply_row_changes(acc, removed[i], added[i], j * TileHeight);
 
                         // Store accumulator
                         auto accTileOut =
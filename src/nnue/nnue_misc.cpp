@@ -26,6 +26,7 @@
 #include <iomanip>
 #include <iosfwd>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string_view>
 
@@ -130,7 +131,9 @@ std::string trace(Position& pos, const Eval::NNUE::Networks& networks) {
 
     // We estimate the value of each piece by doing a differential evaluation from
     // the current base eval, simulating the removal of the piece from its square.
-    Value base = networks.big.evaluate(pos);
+    auto workspace = std::make_unique<NetworkBig::Workspace>();
+
+    Value base = networks.big.evaluate(pos, *workspace);
     base       = pos.side_to_move() == WHITE ? base : -base;
 
     for (File f = FILE_A; f <= FILE_H; ++f)
@@ -149,7 +152,7 @@ std::string trace(Position& pos, const Eval::NNUE::Networks& networks) {
                   st->accumulatorBig.computedPSQT[WHITE] = st->accumulatorBig.computedPSQT[BLACK] =
                     false;
 
-                Value eval = networks.big.evaluate(pos);
+                Value eval = networks.big.evaluate(pos, *workspace);
                 eval       = pos.side_to_move() == WHITE ? eval : -eval;
                 v          = base - eval;
 
@@ -20,6 +20,7 @@
 #define NNUE_MISC_H_INCLUDED
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "../types.h"
@@ -51,6 +52,15 @@ struct NnueEvalTrace {
 };
 
 
+// Time spent by evalbench in each stage of a network, in nanoseconds
+struct NnueEvalProfile {
+    std::uint64_t evals;
+    std::uint64_t transform;
+    std::uint64_t sparse;
+    std::uint64_t dense;
+};
+
+
 struct Networks;
 
 
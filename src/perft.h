@@ -19,8 +19,17 @@
 #ifndef PERFT_H_INCLUDED
 #define PERFT_H_INCLUDED
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "misc.h"
 #include "movegen.h"
 #include "position.h"
 #include "types.h"
@@ -28,41 +37,213 @@
 
 namespace Stockfish {
 
-// Utility to verify move generation. All the leaf nodes up
-// to the given depth are generated and counted, and the sum is returned.
-template<bool Root>
-uint64_t perft(Position& pos, Depth depth) {
+// Leaf counters of perft. The moves of the last ply are broken down by kind
+// only with "go perft <depth> perftstats", that disables the bulk counting.
+struct PerftCounts {
+    uint64_t nodes = 0, captures = 0, enPassants = 0, castles = 0, promotions = 0, checks = 0;
+
+    PerftCounts& operator+=(const PerftCounts& c) {
+        nodes += c.nodes, captures += c.captures, enPassants += c.enPassants;
+        castles += c.castles, promotions += c.promotions, checks += c.checks;
+        return *this;
+    }
+};
+
+// Hash table of the perft counts, set with "go perft <depth> perfthash <MB>" and
+// shared by the threads without locks. An entry stores the key xored with the
+// data, so that an entry torn by two concurrent writes fails the key check
+// instead of giving a wrong count.
+class PerftHash {
+
+    struct Entry {
+        std::atomic<uint64_t> check, data;  // data is (nodes << 8) | depth
+    };
+
+    std::unique_ptr<Entry[]> table;
+    size_t                   count;
+
+    // The same position can be reached at different depths, mix it in the key
+    static Key key_of(Key key, Depth depth) {
+        return key ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    Entry& entry(Key key) { return table[mul_hi64(key, count)]; }
+
+   public:
+    // The table is left empty when it cannot be allocated, see allocated()
+    explicit PerftHash(size_t mbSize) :
+        count(std::max<size_t>(mbSize * 1024 * 1024 / sizeof(Entry), 1)) {
+        table.reset(new (std::nothrow) Entry[count]());
+    }
+
+    bool allocated() const { return bool(table); }
+
+    bool probe(Key key, Depth depth, uint64_t* nodes) {
+        Key      k     = key_of(key, depth);
+        Entry&   e     = entry(k);
+        uint64_t data  = e.data.load(std::memory_order_relaxed);
+        uint64_t check = e.check.load(std::memory_order_relaxed);
+
+        if ((check ^ data) != k || (data & 0xFF) != uint64_t(depth))
+            return false;
+
+        *nodes = data >> 8;
+        return true;
+    }
+
+    void save(Key key, Depth depth, uint64_t nodes) {
+        Key      k    = key_of(key, depth);
+        Entry&   e    = entry(k);
+        uint64_t data = (nodes << 8) | uint64_t(depth);
+
+        e.check.store(k ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+};
+
+// Utility to verify move generation. All the leaf nodes up to the given depth
+// are counted and the sum is returned. The moves of the last ply are counted in
+// bulk, with the size of the move list. Positions from depth 2 are looked up in
+// the hash table, if any.
+inline uint64_t perft(Position& pos, Depth depth, PerftHash* hash) {
+
+    if (depth <= 1)
+        return MoveList<LEGAL>(pos).size();
+
+    uint64_t nodes;
+
+    if (hash && hash->probe(pos.key(), depth, &nodes))
+        return nodes;
 
     StateInfo st;
     ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
-    uint64_t   cnt, nodes = 0;
-    const bool leaf = (depth == 2);
+    nodes = 0;
 
     for (const auto& m : MoveList<LEGAL>(pos))
     {
-        if (Root && depth <= 1)
-            cnt = 1, nodes++;
+        pos.do_move(m, st);
+        nodes += perft(pos, depth - 1, hash);
+        pos.undo_move(m);
+    }
+
+    if (hash)
+        hash->save(pos.key(), depth, nodes);
+
+    return nodes;
+}
+
+// Add a move of the last ply to the counters
+inline void count_leaf(const Position& pos, Move m, PerftCounts& c) {
+
+    c.nodes++;
+    c.captures += pos.capture(m);
+    c.enPassants += m.type_of() == EN_PASSANT;
+    c.castles += m.type_of() == CASTLING;
+    c.promotions += m.type_of() == PROMOTION;
+    c.checks += pos.gives_check(m);
+}
+
+// Like perft() above, but the moves of the last ply are broken down by kind
+inline void perft(Position& pos, Depth depth, PerftCounts& c) {
+
+    StateInfo st;
+    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+        if (depth <= 1)
+            count_leaf(pos, m, c);
         else
         {
             pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - 1);
-            nodes += cnt;
+            perft(pos, depth - 1, c);
             pos.undo_move(m);
         }
-        if (Root)
-            sync_cout << UCI::move(m, pos.is_chess960()) << ": " << cnt << sync_endl;
-    }
-    return nodes;
 }
 
-inline void perft(const std::string& fen, Depth depth, bool isChess960) {
+// Run perft from the given position, with the root moves shared among the
+// threads, each taking the next one not yet counted. The count of each root
+// move is printed at the end, in the order of the move list, so that the output
+// does not depend on the number of threads.
+inline void perft(const std::string& fen,
+                  Depth              depth,
+                  bool               isChess960,
+                  size_t             threadsNb,
+                  size_t             hashMB,
+                  bool               breakdown) {
+
     StateListPtr states(new std::deque<StateInfo>(1));
     Position     p;
     p.set(fen, isChess960, &states->back());
 
-    uint64_t nodes = perft<true>(p, depth);
-    sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+    auto                       moveList = MoveList<LEGAL>(p);
+    std::vector<Move>          rootMoves(moveList.begin(), moveList.end());
+    std::vector<PerftCounts>   counts(rootMoves.size());
+    std::unique_ptr<PerftHash> hash = hashMB && !breakdown ? std::make_unique<PerftHash>(hashMB)
+                                                           : nullptr;
+    std::atomic<size_t>        next{0};
+    TimePoint                  start = now();
+
+    if (hash && !hash->allocated())
+    {
+        sync_cout << "info string Failed to allocate " << hashMB
+                  << "MB for the perft hash, counting without it" << sync_endl;
+        hash.reset();
+    }
+
+    auto count_root_moves = [&]() {
+        StateInfo rootState, st;
+        Position  pos;
+        pos.set(fen, isChess960, &rootState);
+
+        for (size_t i; (i = next++) < rootMoves.size();)
+        {
+            if (depth <= 1)
+            {
+                count_leaf(pos, rootMoves[i], counts[i]);
+                continue;
+            }
+
+            pos.do_move(rootMoves[i], st);
+
+            if (breakdown)
+                perft(pos, depth - 1, counts[i]);
+            else
+                counts[i].nodes = perft(pos, depth - 1, hash.get());
+
+            pos.undo_move(rootMoves[i]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < std::min(threadsNb, rootMoves.size()); ++i)
+        threads.emplace_back(count_root_moves);
+
+    count_root_moves();
+
+    for (std::thread& th : threads)
+        th.join();
+
+    TimePoint   elapsed = now() - start + 1;  // Ensure positivity to avoid a 'divide by zero'
+    PerftCounts total;
+
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        sync_cout << UCI::move(rootMoves[i], isChess960) << ": " << counts[i].nodes << sync_endl;
+        total += counts[i];
+    }
+
+    sync_cout << "\nNodes searched: " << total.nodes;
+
+    if (breakdown)
+        std::cout << "\nCaptures      : " << total.captures
+                  << "\nEn passant    : " << total.enPassants
+                  << "\nCastles       : " << total.castles
+                  << "\nPromotions    : " << total.promotions
+                  << "\nChecks        : " << total.checks;
+
+    std::cout << "\nNodes/second  : " << 1000 * total.nodes / elapsed << "\n" << sync_endl;
 }
 }
 
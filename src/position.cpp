@@ -27,6 +27,7 @@
 #include <initializer_list>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <string_view>
 #include <utility>
@@ -389,6 +390,31 @@ Position& Position::set(const string& code, Color c, StateInfo* si) {
 }
 
 
+// Copies pos without going through a FEN string, as when setting up the root
+// position of the search threads. The state is not copied, si is expected to
+// hold a copy of the one of pos, and earlier states are shared with pos.
+Position& Position::set(const Position& pos, StateInfo* si) {
+
+    std::copy(std::begin(pos.board), std::end(pos.board), board);
+    std::copy(std::begin(pos.byTypeBB), std::end(pos.byTypeBB), byTypeBB);
+    std::copy(std::begin(pos.byColorBB), std::end(pos.byColorBB), byColorBB);
+    std::copy(std::begin(pos.pieceCount), std::end(pos.pieceCount), pieceCount);
+    std::copy(std::begin(pos.castlingRightsMask), std::end(pos.castlingRightsMask),
+              castlingRightsMask);
+    std::copy(std::begin(pos.castlingRookSquare), std::end(pos.castlingRookSquare),
+              castlingRookSquare);
+    std::copy(std::begin(pos.castlingPath), std::end(pos.castlingPath), castlingPath);
+    gamePly    = pos.gamePly;
+    sideToMove = pos.sideToMove;
+    chess960   = pos.chess960;
+    st         = si;
+
+    assert(pos_is_ok());
+
+    return *this;
+}
+
+
 // Returns a FEN representation of the position. In case of
 // Chess960 the Shredder-FEN notation is used. This is mainly a debugging function.
 string Position::fen() const {
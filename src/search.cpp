@@ -22,18 +22,25 @@
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <charconv>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <initializer_list>
+#include <iomanip>
 #include <iostream>
-#include <sstream>
+#include <iterator>
+#include <mutex>
+#include <string>
 #include <utility>
 
+#include "cluster.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
+#include "nnue/network.h"
 #include "nnue/nnue_common.h"
 #include "nnue/nnue_misc.h"
 #include "position.h"
@@ -44,6 +51,13 @@
 #include "uci.h"
 #include "ucioption.h"
 
+// Search statistics by depth, compiled in with "make stats=yes"
+#ifdef SEARCH_STATS
+    #define SEARCH_STAT(s, d) thisThread->stats.add(Search::s, d)
+#else
+    #define SEARCH_STAT(s, d) ((void) 0)
+#endif
+
 namespace Stockfish {
 
 namespace TB = Tablebases;
@@ -85,6 +99,12 @@ int stat_malus(Depth d) { return (d < 4 ? 554 * d - 303 : 1203); }
 // Add a small random component to draw evaluations to avoid 3-fold blindness
 Value value_draw(size_t nodes) { return VALUE_DRAW - 1 + Value(nodes & 0x2); }
 
+// Sizes and phases of the iterations skipped by helper threads with "SMP Depth
+// Skipping". The helper of index idx uses the pattern (idx - 1) % 20: groups of
+// SkipSize iterations, offset by SkipPhase, are alternately searched and skipped.
+constexpr int SkipSize[]  = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int SkipPhase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
 // Skill structure is used to implement strength limit. If we have a UCI_Elo,
 // we convert it to an appropriate skill level, anchored to the Stash engine.
 // This method is based on a fit of the Elo results for games played between
@@ -109,6 +129,13 @@ struct Skill {
     Move   best = Move::none();
 };
 
+// Appends the decimal digits of n to the output buffer, without a stream
+template<typename T>
+void append(std::string& s, T n) {
+    char buf[24];
+    s.append(buf, std::to_chars(buf, buf + sizeof(buf), n).ptr);
+}
+
 Value value_to_tt(Value v, int ply);
 Value value_from_tt(Value v, int ply, int r50c);
 void  update_pv(Move* pv, Move move, const Move* childPv);
@@ -143,28 +170,55 @@ Search::Worker::Worker(SharedState&                    sharedState,
     clear();
 }
 
+Search::Worker::~Worker() = default;
+
+void Search::Worker::allocate_eval_workspace() {
+    evalWorkspace = std::make_unique<Eval::NNUE::EvalWorkspace>();
+}
+
 void Search::Worker::start_searching() {
     // Non-main threads go directly to iterative_deepening()
     if (!is_mainthread())
     {
-        iterative_deepening();
+        rootSplit ? split_root_search() : iterative_deepening();
         return;
     }
 
     main_manager()->tm.init(limits, rootPos.side_to_move(), rootPos.game_ply(), options);
-    tt.new_search();
+    main_manager()->init_output(options);
+    main_manager()->stopReason = "stop";
+    main_manager()->targetTime = main_manager()->tm.optimum();
+
+    if (!threads.sharedTT)
+        tt.new_search();
 
     if (rootMoves.empty())
     {
         rootMoves.emplace_back(Move::none());
-        sync_cout << "info depth 0 score "
-                  << UCI::to_score(rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW, rootPos)
-                  << sync_endl;
+
+        if (!threads.quiet)
+            main_manager()->no_moves(*this);
     }
     else
     {
         threads.start_searching();  // start non-main threads
-        iterative_deepening();      // main thread start searching
+
+        if (rootSplit)
+        {
+            split_root_search();
+
+            // The search is over when the other threads have searched their moves
+            threads.wait_for_search_finished();
+
+            RootMoves merged = threads.split_results();
+            if (!merged.empty())
+                rootMoves = merged;
+
+            if (!threads.quiet)
+                main_manager()->pv(*this, threads, tt, limits.depth, true);
+        }
+        else
+            iterative_deepening();  // main thread start searching
     }
 
     // When we reach the maximum depth, we can arrive here without a raise of
@@ -175,10 +229,19 @@ void Search::Worker::start_searching() {
     while (!threads.stop && (main_manager()->ponder || limits.infinite))
     {}  // Busy wait for a stop or a ponder reset
 
+    // With "Exact Nodes" the helpers search until their own share of the nodes
+    // is used up, so that the work done does not depend on the timing.
+    if (nodeBudget != NoNodeBudget)
+        threads.wait_for_search_finished();
+
     // Stop the threads if not already stopped (also raise the stop if
     // "ponderhit" just reset threads.ponder).
     threads.stop = true;
 
+    // In cluster mode, rank 0 stops the search of the other ranks as well
+    if (clusterMember)
+        Cluster::stop();
+
     // Wait until all threads have finished
     threads.wait_for_search_finished();
 
@@ -192,27 +255,107 @@ void Search::Worker::start_searching() {
     Skill   skill =
       Skill(options["Skill Level"], options["UCI_LimitStrength"] ? int(options["UCI_Elo"]) : 0);
 
-    if (int(options["MultiPV"]) == 1 && !limits.depth && !limits.mate && !skill.enabled()
-        && rootMoves[0].pv[0] != Move::none())
+    bool useVoting = int(options["MultiPV"]) == 1 && !limits.depth && !limits.mate
+                  && !skill.enabled() && rootMoves[0].pv[0] != Move::none();
+
+    if (useVoting)
         bestThread = threads.get_best_thread()->worker.get();
 
     main_manager()->bestPreviousScore        = bestThread->rootMoves[0].score;
     main_manager()->bestPreviousAverageScore = bestThread->rootMoves[0].averageScore;
 
-    // Send again PV info if we have a new best thread
-    if (bestThread != this)
-        sync_cout << main_manager()->pv(*bestThread, threads, tt, bestThread->completedDepth)
-                  << sync_endl;
+    // In cluster mode the ranks vote for the best move like the threads do,
+    // before the final PV is sent so that it agrees with the bestmove. When
+    // another rank wins, its PV is put first in the root moves of bestThread.
+    // The sessions are not part of the cluster.
+    Depth pvDepth     = bestThread->completedDepth;
+    bool  clusterPick = false;
+
+    if (clusterMember)
+    {
+        RootMoves& rms = bestThread->rootMoves;
+
+        if (rms[0].pv.size() == 1)
+            rms[0].extract_ponder_from_tt(tt, rootPos);
 
-    sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
+        std::vector<Move> pv    = rms[0].pv;
+        Value             score = rms[0].score;
 
-    if (bestThread->rootMoves[0].pv.size() > 1
-        || bestThread->rootMoves[0].extract_ponder_from_tt(tt, rootPos))
-        std::cout << " ponder " << UCI::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
+        if (Cluster::vote(pv, score, pvDepth, useVoting))
+        {
+            auto it = std::find(rms.begin(), rms.end(), pv[0]);
 
-    std::cout << sync_endl;
+            if (it != rms.end())
+            {
+                std::rotate(rms.begin(), it, it + 1);
+                rms[0].pv              = pv;
+                rms[0].score           = rms[0].uciScore = score;
+                rms[0].scoreLowerbound = rms[0].scoreUpperbound = false;
+                clusterPick            = true;
+            }
+        }
+    }
+
+    // Send again PV info if we have a new best thread, if the last one was
+    // held back by the rate limit, with "Exact Nodes" for the final count or
+    // when the cluster voted for the move of another rank.
+    if ((bestThread != this || main_manager()->infoPending || nodeBudget != NoNodeBudget
+         || clusterPick)
+        && !threads.quiet)
+        main_manager()->pv(*bestThread, threads, tt, pvDepth, true);
+
+    Move bestMove   = bestThread->rootMoves[0].pv[0];
+    Move ponderMove = bestThread->rootMoves[0].pv.size() > 1
+                         || bestThread->rootMoves[0].extract_ponder_from_tt(tt, rootPos)
+                      ? bestThread->rootMoves[0].pv[1]
+                      : Move::none();
+
+    if (threads.quiet)
+        return;
+
+    if (tbConfig.nonBlocking && threads.tb_cold_probes())
+        main_manager()->tb_probes(*this);
+
+    main_manager()->bestmove(*this, bestMove, ponderMove);
+
+    if (limits.use_time_management() && !std::string(options["Time Log"]).empty())
+        main_manager()->log_time(*this, bestThread->completedDepth);
+}
+
+// Root split mode, an alternative to MultiPV with many threads. Instead of all
+// the threads searching all the root moves, they take the root moves from a
+// work-stealing queue and search each of them on its own, with iterative
+// deepening up to the target depth. SearchManager::pv() merges the results.
+void Search::Worker::split_root_search() {
+
+    size_t moveIdx;
+
+    while (!stopped() && threads.splitQueue.pop(thread_idx, moveIdx))
+    {
+        rootMoves = RootMoves{threads.splitMoves[moveIdx]};
+        rootDepth = completedDepth = 0;
+
+        iterative_deepening();
+
+        splitResults.push_back(rootMoves[0]);
+    }
 }
 
+// The search of this thread is over when the pool is stopped, or when the
+// thread has used up its share of the nodes with "Exact Nodes".
+bool Search::Worker::stopped() const {
+    return threads.stop.load(std::memory_order_relaxed) || out_of_budget();
+}
+
+// Time since the start of the search, read on the main thread. In "nodes as
+// time" mode it is computed from the nodes searched.
+TimePoint Search::Worker::elapsed() const {
+    return main_manager()->tm.elapsed([this]() { return threads.nodes_searched(); });
+}
+
+// Whether the last iteration was cut short, its results cannot be trusted
+bool Search::Worker::aborted() const { return threads.abortedSearch || out_of_budget(); }
+
 // Main iterative deepening loop. It calls search()
 // repeatedly with increasing depth until the allocated thinking time has been
 // consumed, the user stops the search, or the maximum search depth is reached.
@@ -268,12 +411,32 @@ void Search::Worker::iterative_deepening() {
 
     multiPV = std::min(multiPV, rootMoves.size());
 
+    // Diversification of the helper threads, so that they do not all search
+    // the same tree: they may skip iterations, search another root move first
+    // and use wider aspiration windows, depending on their index.
+    const bool skipDepths  = !mainThread && !rootSplit && options["SMP Depth Skipping"];
+    const bool perturbRoot =
+      !mainThread && !rootSplit && options["SMP Root Perturbation"] && multiPV == 1;
+    const int  aspirationSpread =
+      mainThread ? 0 : int(options["SMP Aspiration Spread"]) * int(thread_idx % 4);
+
     int searchAgainCounter = 0;
 
-    // Iterative deepening loop until requested to stop or the target depth is reached
-    while (++rootDepth < MAX_PLY && !threads.stop
-           && !(limits.depth && mainThread && rootDepth > limits.depth))
+    // Iterative deepening loop until requested to stop or the target depth is reached.
+    // The helpers with an "Exact Nodes" budget stop at the target depth too, as the
+    // main thread waits for them instead of stopping them.
+    bool depthLimited = mainThread || rootSplit || nodeBudget != NoNodeBudget;
+
+    while (++rootDepth < MAX_PLY && !stopped()
+           && !(limits.depth && depthLimited && rootDepth > limits.depth))
     {
+        if (skipDepths)
+        {
+            int i = (thread_idx - 1) % 20;
+            if (((rootDepth + rootPos.game_ply() + SkipPhase[i]) / SkipSize[i]) % 2)
+                continue;
+        }
+
         // Age out PV variability metric
         if (mainThread)
             totBestMoveChanges /= 2;
@@ -283,6 +446,14 @@ void Search::Worker::iterative_deepening() {
         for (RootMove& rm : rootMoves)
             rm.previousScore = rm.score;
 
+        // Every third iteration, search one of the next best moves first
+        if (perturbRoot && (rootDepth + thread_idx) % 3 == 0)
+        {
+            size_t k = 1 + (thread_idx - 1) % 3;
+            if (k < rootMoves.size() && rootMoves[k].tbRank == rootMoves[0].tbRank)
+                std::rotate(rootMoves.begin(), rootMoves.begin() + k, rootMoves.begin() + k + 1);
+        }
+
         size_t pvFirst = 0;
         pvLast         = 0;
 
@@ -290,7 +461,7 @@ void Search::Worker::iterative_deepening() {
             searchAgainCounter++;
 
         // MultiPV loop. We perform a full root search for each PV line
-        for (pvIdx = 0; pvIdx < multiPV && !threads.stop; ++pvIdx)
+        for (pvIdx = 0; pvIdx < multiPV && !stopped(); ++pvIdx)
         {
             if (pvIdx == pvLast)
             {
@@ -305,7 +476,7 @@ void Search::Worker::iterative_deepening() {
 
             // Reset aspiration window starting size
             Value avg = rootMoves[pvIdx].averageScore;
-            delta     = 10 + avg * avg / 12493;
+            delta     = (10 + avg * avg / 12493) * (100 + aspirationSpread) / 100;
             alpha     = std::max(avg - delta, -VALUE_INFINITE);
             beta      = std::min(avg + delta, VALUE_INFINITE);
 
@@ -336,14 +507,14 @@ void Search::Worker::iterative_deepening() {
                 // If search has been stopped, we break immediately. Sorting is
                 // safe because RootMoves is still valid, although it refers to
                 // the previous iteration.
-                if (threads.stop)
+                if (stopped())
                     break;
 
                 // When failing high/low give some update (without cluttering
                 // the UI) before a re-search.
-                if (mainThread && multiPV == 1 && (bestValue <= alpha || bestValue >= beta)
-                    && mainThread->tm.elapsed(threads.nodes_searched()) > 3000)
-                    sync_cout << main_manager()->pv(*this, threads, tt, rootDepth) << sync_endl;
+                if (mainThread && !rootSplit && !threads.quiet && multiPV == 1
+                    && (bestValue <= alpha || bestValue >= beta) && elapsed() > 3000)
+                    main_manager()->pv(*this, threads, tt, rootDepth);
 
                 // In case of failing low/high increase aspiration window and
                 // re-search, otherwise exit the loop.
@@ -372,23 +543,25 @@ void Search::Worker::iterative_deepening() {
             // Sort the PV lines searched so far and update the GUI
             std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
-            if (mainThread
-                && (threads.stop || pvIdx + 1 == multiPV
-                    || mainThread->tm.elapsed(threads.nodes_searched()) > 3000)
+            if (mainThread && !rootSplit && !threads.quiet
+                && (stopped() || pvIdx + 1 == multiPV || elapsed() > 3000)
                 // A thread that aborted search can have mated-in/TB-loss PV and score
                 // that cannot be trusted, i.e. it can be delayed or refuted if we would have
                 // had time to fully search other root-moves. Thus we suppress this output and
                 // below pick a proven score/PV for this thread (from the previous iteration).
-                && !(threads.abortedSearch && rootMoves[0].uciScore <= VALUE_TB_LOSS_IN_MAX_PLY))
-                sync_cout << main_manager()->pv(*this, threads, tt, rootDepth) << sync_endl;
+                && !(aborted() && rootMoves[0].uciScore <= VALUE_TB_LOSS_IN_MAX_PLY))
+                main_manager()->pv(*this, threads, tt, rootDepth);
         }
 
-        if (!threads.stop)
+        if (!stopped())
             completedDepth = rootDepth;
 
+        if (clusterMember)
+            Cluster::flush(clusterBuffer);
+
         // We make sure not to pick an unproven mated-in score,
         // in case this thread prematurely stopped search (aborted-search).
-        if (threads.abortedSearch && rootMoves[0].score != -VALUE_INFINITE
+        if (aborted() && rootMoves[0].score != -VALUE_INFINITE
             && rootMoves[0].score <= VALUE_TB_LOSS_IN_MAX_PLY)
         {
             // Bring the last best move to the front for best thread selection.
@@ -414,12 +587,21 @@ void Search::Worker::iterative_deepening() {
                 || (rootMoves[0].score != -VALUE_INFINITE
                     && rootMoves[0].score <= VALUE_MATED_IN_MAX_PLY
                     && VALUE_MATE + rootMoves[0].score <= 2 * limits.mate)))
-            threads.stop = true;
+        {
+            mainThread->stopReason = "mate";
+            threads.stop           = true;
+        }
 
         // If the skill level is enabled and time is up, pick a sub-optimal best move
         if (skill.enabled() && skill.time_to_pick(rootDepth))
             skill.pick_best(rootMoves, multiPV);
 
+        // In root split mode the main thread searches a single root move, which
+        // says nothing about the time the whole search needs. Only the maximum
+        // time, checked in check_time(), limits it.
+        if (rootSplit)
+            continue;
+
         // Use part of the gained time from a previous stable move for the current move
         for (Thread* th : threads)
         {
@@ -450,25 +632,30 @@ void Search::Worker::iterative_deepening() {
             if (rootMoves.size() == 1)
                 totalTime = std::min(500.0, totalTime);
 
-            if (completedDepth >= 10 && nodesEffort >= 97
-                && mainThread->tm.elapsed(threads.nodes_searched()) > totalTime * 0.739
+            mainThread->targetTime = TimePoint(totalTime);
+
+            if (completedDepth >= 10 && nodesEffort >= 97 && elapsed() > totalTime * 0.739
                 && !mainThread->ponder)
-                threads.stop = true;
+            {
+                mainThread->stopReason = "effort";
+                threads.stop           = true;
+            }
 
             // Stop the search if we have exceeded the totalTime
-            if (mainThread->tm.elapsed(threads.nodes_searched()) > totalTime)
+            if (elapsed() > totalTime)
             {
                 // If we are allowed to ponder do not stop the search now but
                 // keep pondering until the GUI sends "ponderhit" or "stop".
                 if (mainThread->ponder)
                     mainThread->stopOnPonderhit = true;
-                else
-                    threads.stop = true;
+                else if (!threads.stop)
+                {
+                    mainThread->stopReason = "target";
+                    threads.stop           = true;
+                }
             }
             else
-                threads.increaseDepth =
-                  mainThread->ponder
-                  || mainThread->tm.elapsed(threads.nodes_searched()) <= totalTime * 0.506;
+                threads.increaseDepth = mainThread->ponder || elapsed() <= totalTime * 0.506;
         }
 
         mainThread->iterValue[iterIdx] = bestValue;
@@ -478,7 +665,11 @@ void Search::Worker::iterative_deepening() {
     if (!mainThread)
         return;
 
-    mainThread->previousTimeReduction = timeReduction;
+    if (!threads.stop)
+        mainThread->stopReason = "depth";
+
+    if (!rootSplit)
+        mainThread->previousTimeReduction = timeReduction;
 
     // If the skill level is enabled, swap the best PV line with the sub-optimal one
     if (skill.enabled())
@@ -500,8 +691,14 @@ void Search::Worker::clear() {
                 for (auto& h : to)
                     h->fill(-67);
 
+    init_reductions();
+}
+
+// The reductions depend on the number of threads of the pool
+void Search::Worker::init_reductions() {
     for (size_t i = 1; i < reductions.size(); ++i)
-        reductions[i] = int((19.80 + std::log(size_t(options["Threads"])) / 2) * std::log(i));
+        reductions[i] =
+          int((19.80 + std::log(std::max<size_t>(threads.size(), 1)) / 2) * std::log(i));
 }
 
 
@@ -562,13 +759,14 @@ Value Search::Worker::search(
     if (PvNode && thisThread->selDepth < ss->ply + 1)
         thisThread->selDepth = ss->ply + 1;
 
+    SEARCH_STAT(STAT_CALLS, depth);
+
     if (!rootNode)
     {
         // Step 2. Check for aborted search and immediate draw
-        if (threads.stop.load(std::memory_order_relaxed) || pos.is_draw(ss->ply)
-            || ss->ply >= MAX_PLY)
+        if (thisThread->stopped() || pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
             return (ss->ply >= MAX_PLY && !ss->inCheck)
-                   ? evaluate(networks, pos, thisThread->optimism[us])
+                   ? evaluate(networks, *evalWorkspace, pos, thisThread->optimism[us])
                    : value_draw(thisThread->nodes);
 
         // Step 3. Mate distance pruning. Even if we mate at the next move our score
@@ -631,9 +829,12 @@ Value Search::Worker::search(
         // Partial workaround for the graph history interaction problem
         // For high rule50 counts don't produce transposition table cutoffs.
         if (pos.rule50_count() < 90)
+        {
+            SEARCH_STAT(STAT_TT_CUTOFF, depth);
             return ttValue >= beta && std::abs(ttValue) < VALUE_TB_WIN_IN_MAX_PLY
                    ? (ttValue * 3 + beta) / 4
                    : ttValue;
+        }
     }
 
     // Step 5. Tablebases probe
@@ -646,13 +847,17 @@ Value Search::Worker::search(
             && pos.rule50_count() == 0 && !pos.can_castle(ANY_CASTLING))
         {
             TB::ProbeState err;
-            TB::WDLScore   wdl = Tablebases::probe_wdl(pos, &err);
+            TB::WDLScore   wdl = Tablebases::probe_wdl(pos, &err, !tbConfig.nonBlocking);
 
             // Force check of time on the next occasion
             if (is_mainthread())
                 main_manager()->callsCnt = 0;
 
-            if (err != TB::ProbeState::FAIL)
+            // The table data is being read in the background, search on as if
+            // the position were not in the tablebases.
+            if (err == TB::ProbeState::COLD)
+                thisThread->tbColdProbes.fetch_add(1, std::memory_order_relaxed);
+            else if (err != TB::ProbeState::FAIL)
             {
                 thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
 
@@ -710,7 +915,8 @@ Value Search::Worker::search(
         // Never assume anything about values stored in TT
         unadjustedStaticEval = tte->eval();
         if (unadjustedStaticEval == VALUE_NONE)
-            unadjustedStaticEval = evaluate(networks, pos, thisThread->optimism[us]);
+            unadjustedStaticEval =
+              evaluate(networks, *evalWorkspace, pos, thisThread->optimism[us]);
         else if (PvNode)
             Eval::NNUE::hint_common_parent_position(pos, networks);
 
@@ -722,7 +928,7 @@ Value Search::Worker::search(
     }
     else
     {
-        unadjustedStaticEval = evaluate(networks, pos, thisThread->optimism[us]);
+        unadjustedStaticEval = evaluate(networks, *evalWorkspace, pos, thisThread->optimism[us]);
         ss->staticEval = eval = to_corrected_static_eval(unadjustedStaticEval, *thisThread, pos);
 
         // Static evaluation is saved as it was before adjustment by correction history
@@ -760,7 +966,10 @@ Value Search::Worker::search(
     {
         value = qsearch<NonPV>(pos, ss, alpha - 1, alpha);
         if (value < alpha)
+        {
+            SEARCH_STAT(STAT_RAZORING, depth);
             return value;
+        }
     }
 
     // Step 8. Futility pruning: child node (~40 Elo)
@@ -770,7 +979,10 @@ Value Search::Worker::search(
                - (ss - 1)->statScore / 267
              >= beta
         && eval >= beta && eval < VALUE_TB_WIN_IN_MAX_PLY && (!ttMove || ttCapture))
+    {
+        SEARCH_STAT(STAT_FUTILITY_CUTOFF, depth);
         return beta > VALUE_TB_LOSS_IN_MAX_PLY ? (eval + beta) / 2 : eval;
+    }
 
     // Step 9. Null move search with verification search (~35 Elo)
     if (!PvNode && (ss - 1)->currentMove != Move::null() && (ss - 1)->statScore < 16878
@@ -792,11 +1004,17 @@ Value Search::Worker::search(
 
         pos.undo_null_move();
 
+        if (thisThread->out_of_budget())
+            return VALUE_ZERO;
+
         // Do not return unproven mate or TB scores
         if (nullValue >= beta && nullValue < VALUE_TB_WIN_IN_MAX_PLY)
         {
             if (thisThread->nmpMinPly || depth < 16)
+            {
+                SEARCH_STAT(STAT_NULL_CUTOFF, depth);
                 return nullValue;
+            }
 
             assert(!thisThread->nmpMinPly);  // Recursive verification is not allowed
 
@@ -809,7 +1027,10 @@ Value Search::Worker::search(
             thisThread->nmpMinPly = 0;
 
             if (v >= beta)
+            {
+                SEARCH_STAT(STAT_NULL_CUTOFF, depth);
                 return nullValue;
+            }
         }
     }
 
@@ -856,7 +1077,10 @@ Value Search::Worker::search(
                   &this
                      ->continuationHistory[ss->inCheck][true][pos.moved_piece(move)][move.to_sq()];
 
-                thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+                if (thisThread->out_of_budget())
+                    return VALUE_ZERO;
+
+                thisThread->count_node();
                 pos.do_move(move, st);
 
                 // Perform a preliminary qsearch to verify that the move holds
@@ -869,8 +1093,13 @@ Value Search::Worker::search(
 
                 pos.undo_move(move);
 
+                if (thisThread->out_of_budget())
+                    return VALUE_ZERO;
+
                 if (value >= probCutBeta)
                 {
+                    SEARCH_STAT(STAT_PROBCUT, depth);
+
                     // Save ProbCut data into transposition table
                     tte->save(posKey, value_to_tt(value, ss->ply), ss->ttPv, BOUND_LOWER, depth - 3,
                               move, unadjustedStaticEval, tt.generation());
@@ -889,7 +1118,10 @@ moves_loop:  // When in check, search starts here
     if (ss->inCheck && !PvNode && ttCapture && (tte->bound() & BOUND_LOWER)
         && tte->depth() >= depth - 4 && ttValue >= probCutBeta
         && std::abs(ttValue) < VALUE_TB_WIN_IN_MAX_PLY && std::abs(beta) < VALUE_TB_WIN_IN_MAX_PLY)
+    {
+        SEARCH_STAT(STAT_PROBCUT, depth);
         return probCutBeta;
+    }
 
     const PieceToHistory* contHist[] = {(ss - 1)->continuationHistory,
                                         (ss - 2)->continuationHistory,
@@ -930,11 +1162,8 @@ moves_loop:  // When in check, search starts here
 
         ss->moveCount = ++moveCount;
 
-        if (rootNode && is_mainthread()
-            && main_manager()->tm.elapsed(threads.nodes_searched()) > 3000)
-            sync_cout << "info depth " << depth << " currmove "
-                      << UCI::move(move, pos.is_chess960()) << " currmovenumber "
-                      << moveCount + thisThread->pvIdx << sync_endl;
+        if (rootNode && is_mainthread() && !rootSplit && !threads.quiet && elapsed() > 3000)
+            main_manager()->currmove(*this, depth, move, moveCount + thisThread->pvIdx);
         if (PvNode)
             (ss + 1)->pv = nullptr;
 
@@ -972,12 +1201,18 @@ moves_loop:  // When in check, search starts here
                       + thisThread->captureHistory[movedPiece][move.to_sq()][type_of(capturedPiece)]
                           / 7;
                     if (futilityEval < alpha)
+                    {
+                        SEARCH_STAT(STAT_FUTILITY_PRUNE, depth);
                         continue;
+                    }
                 }
 
                 // SEE based pruning for captures and checks (~11 Elo)
                 if (!pos.see_ge(move, -203 * depth))
+                {
+                    SEARCH_STAT(STAT_SEE_PRUNE, depth);
                     continue;
+                }
             }
             else
             {
@@ -989,7 +1224,10 @@ moves_loop:  // When in check, search starts here
 
                 // Continuation history based pruning (~2 Elo)
                 if (lmrDepth < 6 && history < -4040 * depth)
+                {
+                    SEARCH_STAT(STAT_HISTORY_PRUNE, depth);
                     continue;
+                }
 
                 history += 2 * thisThread->mainHistory[us][move.from_to()];
 
@@ -1004,6 +1242,7 @@ moves_loop:  // When in check, search starts here
                     if (bestValue <= futilityValue && std::abs(bestValue) < VALUE_TB_WIN_IN_MAX_PLY
                         && futilityValue < VALUE_TB_WIN_IN_MAX_PLY)
                         bestValue = (bestValue + futilityValue * 3) / 4;
+                    SEARCH_STAT(STAT_FUTILITY_PRUNE, depth);
                     continue;
                 }
 
@@ -1011,7 +1250,10 @@ moves_loop:  // When in check, search starts here
 
                 // Prune moves with negative SEE (~4 Elo)
                 if (!pos.see_ge(move, -27 * lmrDepth * lmrDepth))
+                {
+                    SEARCH_STAT(STAT_SEE_PRUNE, depth);
                     continue;
+                }
             }
         }
 
@@ -1042,6 +1284,9 @@ moves_loop:  // When in check, search starts here
                   search<NonPV>(pos, ss, singularBeta - 1, singularBeta, singularDepth, cutNode);
                 ss->excludedMove = Move::none();
 
+                if (thisThread->out_of_budget())
+                    return VALUE_ZERO;
+
                 if (value < singularBeta)
                 {
                     extension = 1;
@@ -1106,8 +1351,12 @@ moves_loop:  // When in check, search starts here
 
         uint64_t nodeCount = rootNode ? uint64_t(nodes) : 0;
 
-        // Step 16. Make the move
-        thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+        // Step 16. Make the move. Razoring, ProbCut or the null move verification
+        // may have used up the node budget, so check it before counting the node.
+        if (thisThread->out_of_budget())
+            return VALUE_ZERO;
+
+        thisThread->count_node();
         pos.do_move(move, st, givesCheck);
 
         // Decrease reduction if position is or has been on the PV (~7 Elo)
@@ -1153,6 +1402,7 @@ moves_loop:  // When in check, search starts here
             // std::clamp has been replaced by a more robust implementation.
             Depth d = std::max(1, std::min(newDepth - r, newDepth + 1));
 
+            SEARCH_STAT(STAT_LMR, depth);
             value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, d, true);
 
             // Do a full-depth search when reduced LMR search fails high
@@ -1166,7 +1416,10 @@ moves_loop:  // When in check, search starts here
                 newDepth += doDeeperSearch - doShallowerSearch;
 
                 if (newDepth > d)
+                {
+                    SEARCH_STAT(STAT_RESEARCH, depth);
                     value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, newDepth, !cutNode);
+                }
 
                 // Post LMR continuation history updates (~1 Elo)
                 int bonus = value <= alpha ? -stat_malus(newDepth)
@@ -1192,6 +1445,9 @@ moves_loop:  // When in check, search starts here
         // otherwise let the parent node fail low with value <= alpha and try another move.
         if (PvNode && (moveCount == 1 || value > alpha))
         {
+            if (moveCount > 1)
+                SEARCH_STAT(STAT_RESEARCH, depth);
+
             (ss + 1)->pv    = pv;
             (ss + 1)->pv[0] = Move::none();
 
@@ -1207,7 +1463,7 @@ moves_loop:  // When in check, search starts here
         // Finished searching the move. If a stop occurred, the return value of
         // the search cannot be trusted, and we return immediately without
         // updating best move, PV and TT.
-        if (threads.stop.load(std::memory_order_relaxed))
+        if (thisThread->stopped())
             return VALUE_ZERO;
 
         if (rootNode)
@@ -1273,6 +1529,9 @@ moves_loop:  // When in check, search starts here
                 {
                     ss->cutoffCnt += 1 + !ttMove;
                     assert(value >= beta);  // Fail high
+                    SEARCH_STAT(STAT_FAIL_HIGH, depth);
+                    if (moveCount == 1)
+                        SEARCH_STAT(STAT_FAIL_HIGH_FIRST, depth);
                     break;
                 }
                 else
@@ -1341,11 +1600,19 @@ moves_loop:  // When in check, search starts here
     // Write gathered information in transposition table
     // Static evaluation is saved as it was before correction history
     if (!excludedMove && !(rootNode && thisThread->pvIdx))
-        tte->save(posKey, value_to_tt(bestValue, ss->ply), ss->ttPv,
-                  bestValue >= beta    ? BOUND_LOWER
-                  : PvNode && bestMove ? BOUND_EXACT
-                                       : BOUND_UPPER,
-                  depth, bestMove, unadjustedStaticEval, tt.generation());
+    {
+        Bound b = bestValue >= beta    ? BOUND_LOWER
+                : PvNode && bestMove ? BOUND_EXACT
+                                     : BOUND_UPPER;
+
+        tte->save(posKey, value_to_tt(bestValue, ss->ply), ss->ttPv, b, depth, bestMove,
+                  unadjustedStaticEval, tt.generation());
+
+        // In cluster mode, share the deep entries with the other ranks
+        if (depth >= Cluster::BroadcastDepth && thisThread->clusterMember)
+            Cluster::save(thisThread->clusterBuffer, posKey, value_to_tt(bestValue, ss->ply),
+                          ss->ttPv, b, depth, bestMove, unadjustedStaticEval);
+    }
 
     // Adjust correction history
     if (!ss->inCheck && (!bestMove || !pos.capture(bestMove))
@@ -1394,7 +1661,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     Move     ttMove, move, bestMove;
     Depth    ttDepth;
     Value    bestValue, value, ttValue, futilityValue, futilityBase;
-    bool     pvHit, givesCheck, capture;
+    bool     pvHit, givesCheck, capture, lazyEval = false;
     int      moveCount;
     Color    us = pos.side_to_move();
 
@@ -1414,10 +1681,16 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     if (PvNode && thisThread->selDepth < ss->ply + 1)
         thisThread->selDepth = ss->ply + 1;
 
-    // Step 2. Check for an immediate draw or maximum ply reached
+    SEARCH_STAT(STAT_CALLS, 0);
+
+    // Step 2. Check for an exhausted node budget, an immediate draw or maximum
+    // ply reached
+    if (thisThread->out_of_budget())
+        return VALUE_ZERO;
+
     if (pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
         return (ss->ply >= MAX_PLY && !ss->inCheck)
-               ? evaluate(networks, pos, thisThread->optimism[us])
+               ? evaluate(networks, *evalWorkspace, pos, thisThread->optimism[us])
                : VALUE_DRAW;
 
     assert(0 <= ss->ply && ss->ply < MAX_PLY);
@@ -1436,7 +1709,10 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     if (!PvNode && tte->depth() >= ttDepth
         && ttValue != VALUE_NONE  // Only in case of TT access race or if !ttHit
         && (tte->bound() & (ttValue >= beta ? BOUND_LOWER : BOUND_UPPER)))
+    {
+        SEARCH_STAT(STAT_TT_CUTOFF, 0);
         return ttValue;
+    }
 
     // Step 4. Static evaluation of the position
     Value unadjustedStaticEval = VALUE_NONE;
@@ -1449,7 +1725,8 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
             // Never assume anything about values stored in TT
             unadjustedStaticEval = tte->eval();
             if (unadjustedStaticEval == VALUE_NONE)
-                unadjustedStaticEval = evaluate(networks, pos, thisThread->optimism[us]);
+                unadjustedStaticEval =
+                  evaluate(networks, *evalWorkspace, pos, thisThread->optimism[us]);
             ss->staticEval = bestValue =
               to_corrected_static_eval(unadjustedStaticEval, *thisThread, pos);
 
@@ -1460,20 +1737,33 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
         }
         else
         {
-            // In case of null move search, use previous static eval with a different sign
-            unadjustedStaticEval = (ss - 1)->currentMove != Move::null()
-                                   ? evaluate(networks, pos, thisThread->optimism[us])
-                                   : -(ss - 1)->staticEval;
-            ss->staticEval       = bestValue =
+            // In case of null move search, use previous static eval with a different sign.
+            // Otherwise, with "Lazy Stand Pat", evaluate lazily: if the PSQT term alone
+            // is well above beta we stand pat on it and skip the full network pass.
+            unadjustedStaticEval =
+              (ss - 1)->currentMove == Move::null() ? -(ss - 1)->staticEval
+              : thisThread->lazyStandPat
+                ? evaluate(networks, *evalWorkspace, pos, thisThread->optimism[us],
+                           -VALUE_INFINITE, beta, lazyEval)
+                : evaluate(networks, *evalWorkspace, pos, thisThread->optimism[us]);
+            ss->staticEval = bestValue =
               to_corrected_static_eval(unadjustedStaticEval, *thisThread, pos);
+
+            if (lazyEval)
+                thisThread->lazyEvals.fetch_add(1, std::memory_order_relaxed);
         }
 
+        assert(!lazyEval || bestValue >= beta);
+
         // Stand pat. Return immediately if static value is at least beta
         if (bestValue >= beta)
         {
+            // A lazy static eval is only an estimate. It is stored as the value, a
+            // lower bound, but not as the static eval of the entry.
             if (!ss->ttHit)
                 tte->save(posKey, value_to_tt(bestValue, ss->ply), false, BOUND_LOWER, DEPTH_NONE,
-                          Move::none(), unadjustedStaticEval, tt.generation());
+                          Move::none(), lazyEval ? VALUE_NONE : unadjustedStaticEval,
+                          tt.generation());
 
             return bestValue;
         }
@@ -1520,7 +1810,10 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
                 && move.type_of() != PROMOTION)
             {
                 if (moveCount > 2)
+                {
+                    SEARCH_STAT(STAT_FUTILITY_PRUNE, 0);
                     continue;
+                }
 
                 futilityValue = futilityBase + PieceValue[pos.piece_on(move.to_sq())];
 
@@ -1529,6 +1822,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
                 if (futilityValue <= alpha)
                 {
                     bestValue = std::max(bestValue, futilityValue);
+                    SEARCH_STAT(STAT_FUTILITY_PRUNE, 0);
                     continue;
                 }
 
@@ -1537,6 +1831,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
                 if (futilityBase <= alpha && !pos.see_ge(move, 1))
                 {
                     bestValue = std::max(bestValue, futilityBase);
+                    SEARCH_STAT(STAT_FUTILITY_PRUNE, 0);
                     continue;
                 }
 
@@ -1545,6 +1840,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
                 if (futilityBase > alpha && !pos.see_ge(move, (alpha - futilityBase) * 4))
                 {
                     bestValue = alpha;
+                    SEARCH_STAT(STAT_SEE_PRUNE, 0);
                     continue;
                 }
             }
@@ -1558,11 +1854,17 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
             // Continuation history based pruning (~3 Elo)
             if (!capture && (*contHist[0])[pos.moved_piece(move)][move.to_sq()] < 0
                 && (*contHist[1])[pos.moved_piece(move)][move.to_sq()] < 0)
+            {
+                SEARCH_STAT(STAT_HISTORY_PRUNE, 0);
                 continue;
+            }
 
             // Do not search moves with bad enough SEE values (~5 Elo)
             if (!pos.see_ge(move, -78))
+            {
+                SEARCH_STAT(STAT_SEE_PRUNE, 0);
                 continue;
+            }
         }
 
         // Speculative prefetch as early as possible
@@ -1577,11 +1879,15 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
         quietCheckEvasions += !capture && ss->inCheck;
 
         // Step 7. Make and search the move
-        thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+        thisThread->count_node();
         pos.do_move(move, st, givesCheck);
         value = -qsearch<nodeType>(pos, ss + 1, -beta, -alpha, depth - 1);
         pos.undo_move(move);
 
+        // Only an exhausted node budget stops the search inside qsearch
+        if (thisThread->out_of_budget())
+            return VALUE_ZERO;
+
         assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
         // Step 8. Check for a new best move
@@ -1599,7 +1905,12 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
                 if (value < beta)  // Update alpha here!
                     alpha = value;
                 else
+                {
+                    SEARCH_STAT(STAT_FAIL_HIGH, 0);
+                    if (moveCount == 1)
+                        SEARCH_STAT(STAT_FAIL_HIGH_FIRST, 0);
                     break;  // Fail high
+                }
             }
         }
     }
@@ -1844,9 +2155,15 @@ void SearchManager::check_time(Search::Worker& worker) {
     // When using nodes, ensure checking rate is not lower than 0.1% of nodes
     callsCnt = worker.limits.nodes ? std::min(512, int(worker.limits.nodes / 1024)) : 512;
 
-    static TimePoint lastInfoTime = now();
+    // The node count is only needed in 'nodes as time' mode and with a node limit.
+    // The published counts lag by up to NodesPublishPeriod nodes per helper, so a
+    // node limit is checked on the exact sum, as a helper may overshoot it otherwise.
+    auto nodes = [&]() {
+        return worker.limits.nodes ? worker.threads.nodes_searched()
+                                   : worker.threads.nodes_published();
+    };
 
-    TimePoint elapsed = tm.elapsed(worker.threads.nodes_searched());
+    TimePoint elapsed = tm.elapsed(nodes);
     TimePoint tick    = worker.limits.startTime + elapsed;
 
     if (tick - lastInfoTime >= 1000)
@@ -1855,33 +2172,112 @@ void SearchManager::check_time(Search::Worker& worker) {
         dbg_print();
     }
 
+    if (worker.clusterMember)
+        Cluster::apply_received(worker.tt);
+
     // We should not stop pondering until told so by the GUI
     if (ponder)
         return;
 
-    if (
-      // Later we rely on the fact that we can at least use the mainthread previous
-      // root-search score and PV in a multithreaded environment to prove mated-in scores.
-      worker.completedDepth >= 1
-      && ((worker.limits.use_time_management() && (elapsed > tm.maximum() || stopOnPonderhit))
-          || (worker.limits.movetime && elapsed >= worker.limits.movetime)
-          || (worker.limits.nodes && worker.threads.nodes_searched() >= worker.limits.nodes)))
+    // Later we rely on the fact that we can at least use the mainthread previous
+    // root-search score and PV in a multithreaded environment to prove mated-in scores.
+    if (worker.completedDepth < 1)
+        return;
+
+    // In cluster mode the other ranks stop when rank 0 does, see Cluster::stop()
+    if (worker.clusterMember && Cluster::stop_requested())
+    {
+        stopReason          = "cluster";
         worker.threads.stop = worker.threads.abortedSearch = true;
+        return;
+    }
+
+    const char* reason =
+      worker.limits.use_time_management() && elapsed > tm.maximum() ? "maximum"
+      : worker.limits.use_time_management() && stopOnPonderhit       ? "ponderhit"
+      : worker.limits.movetime && elapsed >= worker.limits.movetime   ? "movetime"
+      : worker.limits.nodes && worker.nodeBudget == NoNodeBudget && nodes() >= worker.limits.nodes
+        ? "nodes"
+        : nullptr;
+
+    if (reason)
+    {
+        stopReason          = reason;
+        worker.threads.stop = worker.threads.abortedSearch = true;
+    }
 }
 
-std::string SearchManager::pv(const Search::Worker&     worker,
-                              const ThreadPool&         threads,
-                              const TranspositionTable& tt,
-                              Depth                     depth) const {
-    std::stringstream ss;
+// Appends the time spent on the move to the "Time Log" file. The sessions may
+// share the file, hence the lock.
+void SearchManager::log_time(const Search::Worker& worker, Depth depth) {
 
-    const auto  nodes     = threads.nodes_searched();
-    const auto& rootMoves = worker.rootMoves;
+    static std::mutex mutex;
+
+    const auto&  limits = worker.limits;
+    const Color  us     = worker.rootPos.side_to_move();
+    TimeRecord   r;
+
+    r.ply       = worker.rootPos.game_ply();
+    r.time      = limits.time[us];
+    r.inc       = limits.inc[us];
+    r.movestogo = limits.movestogo;
+    r.overhead  = TimePoint(worker.options["Move Overhead"]);
+    r.optimum   = tm.optimum();
+    r.maximum   = tm.maximum();
+    r.target    = targetTime;
+    r.actual    = worker.elapsed();
+    r.depth     = depth;
+    r.stop      = stopReason;
+
+    std::lock_guard<std::mutex> lk(mutex);
+    std::ofstream               file(std::string(worker.options["Time Log"]), std::ios::app);
+
+    file << worker.threads.tag << r << std::endl;
+}
+
+void SearchManager::init_output(const OptionsMap& options) {
+
+    jsonOutput   = options["Info Format"] == "json";
+    infoInterval = options["Info Interval"];
+    lastInfo     = -infoInterval;
+    infoPending  = false;
+}
+
+// Sends the PV lines, one per MultiPV line, as UCI info or as JSON objects.
+// With an "Info Interval" the lines are rate limited unless forced, and what
+// is skipped is sent again when the search ends.
+void SearchManager::pv(const Search::Worker&     worker,
+                       const ThreadPool&         threads,
+                       const TranspositionTable& tt,
+                       Depth                     depth,
+                       bool                      force) {
+
+    const auto nodes = threads.nodes_searched();
+    TimePoint  time  = tm.elapsed([nodes]() { return nodes; }) + 1;
+
+    if (!force && time - lastInfo < infoInterval)
+    {
+        infoPending = true;
+        return;
+    }
+
+    lastInfo    = time;
+    infoPending = false;
+
+    // In root split mode, the root moves are merged from all the threads
+    RootMoves merged;
+    if (worker.rootSplit)
+        merged = threads.split_results();
+
+    const auto& rootMoves = worker.rootSplit ? merged : worker.rootMoves;
     const auto& pos       = worker.rootPos;
-    size_t      pvIdx     = worker.pvIdx;
-    TimePoint   time      = tm.elapsed(nodes) + 1;
+    size_t      pvIdx     = worker.rootSplit ? rootMoves.size() : worker.pvIdx;
     size_t      multiPV   = std::min(size_t(worker.options["MultiPV"]), rootMoves.size());
     uint64_t    tbHits    = threads.tb_hits() + (worker.tbConfig.rootInTB ? rootMoves.size() : 0);
+    bool        showWDL   = worker.options["UCI_ShowWDL"];
+    int         hashfull  = tt.hashfull();
+
+    out.clear();
 
     for (size_t i = 0; i < multiPV; ++i)
     {
@@ -1899,29 +2295,200 @@ std::string SearchManager::pv(const Search::Worker&     worker,
         bool tb = worker.tbConfig.rootInTB && std::abs(v) <= VALUE_TB;
         v       = tb ? rootMoves[i].tbScore : v;
 
-        if (ss.rdbuf()->in_avail())  // Not at first line
-            ss << "\n";
+        const char* bound = nullptr;
+        if (i == pvIdx && !tb && updated)  // tablebase- and previous-scores are exact
+            bound = rootMoves[i].scoreLowerbound ? "lowerbound"
+                  : rootMoves[i].scoreUpperbound ? "upperbound"
+                                                 : nullptr;
 
-        ss << "info"
-           << " depth " << d << " seldepth " << rootMoves[i].selDepth << " multipv " << i + 1
-           << " score " << UCI::to_score(v, pos);
+        auto [unit, n] = UCI::score_parts(v, pos);
 
-        if (worker.options["UCI_ShowWDL"])
-            ss << UCI::wdl(v, pos);
+        out += threads.tag;
 
-        if (i == pvIdx && !tb && updated)  // tablebase- and previous-scores are exact
-            ss << (rootMoves[i].scoreLowerbound
-                     ? " lowerbound"
-                     : (rootMoves[i].scoreUpperbound ? " upperbound" : ""));
+        if (jsonOutput)
+        {
+            out += "{\"depth\":", append(out, d);
+            out += ",\"seldepth\":", append(out, rootMoves[i].selDepth);
+            out += ",\"multipv\":", append(out, i + 1);
+            out += ",\"score\":{\"", out += unit, out += "\":", append(out, n), out += '}';
+
+            if (showWDL)
+            {
+                auto [w, dr, l] = UCI::wdl_parts(v, pos);
+                out += ",\"wdl\":[", append(out, w), out += ',', append(out, dr);
+                out += ',', append(out, l), out += ']';
+            }
+
+            if (bound)
+                out += ",\"bound\":\"", out += bound, out += '"';
+
+            out += ",\"nodes\":", append(out, nodes);
+            out += ",\"nps\":", append(out, nodes * 1000 / time);
+            out += ",\"hashfull\":", append(out, hashfull);
+            out += ",\"tbhits\":", append(out, tbHits);
+            out += ",\"time\":", append(out, time);
+            out += ",\"pv\":[";
+
+            for (size_t j = 0; j < rootMoves[i].pv.size(); ++j)
+            {
+                out += j ? ",\"" : "\"";
+                out += UCI::move(rootMoves[i].pv[j], pos.is_chess960());
+                out += '"';
+            }
+
+            out += "]}\n";
+        }
+        else
+        {
+            out += "info depth ", append(out, d);
+            out += " seldepth ", append(out, rootMoves[i].selDepth);
+            out += " multipv ", append(out, i + 1);
+            out += " score ", out += unit, out += ' ', append(out, n);
+
+            if (showWDL)
+            {
+                auto [w, dr, l] = UCI::wdl_parts(v, pos);
+                out += " wdl ", append(out, w), out += ' ', append(out, dr);
+                out += ' ', append(out, l);
+            }
+
+            if (bound)
+                out += ' ', out += bound;
+
+            out += " nodes ", append(out, nodes);
+            out += " nps ", append(out, nodes * 1000 / time);
+            out += " hashfull ", append(out, hashfull);
+            out += " tbhits ", append(out, tbHits);
+            out += " time ", append(out, time);
+            out += " pv";
+
+            for (Move m : rootMoves[i].pv)
+                out += ' ', out += UCI::move(m, pos.is_chess960());
+
+            out += '\n';
+        }
+    }
+
+    async_cout(out);
+}
+
+void SearchManager::currmove(const Search::Worker& worker, Depth depth, Move move, int moveNumber) {
+
+    out.clear();
+    out += worker.threads.tag;
+    out += jsonOutput ? "{\"depth\":" : "info depth ", append(out, depth);
+    out += jsonOutput ? ",\"currmove\":\"" : " currmove ";
+    out += UCI::move(move, worker.rootPos.is_chess960());
+    out += jsonOutput ? "\",\"currmovenumber\":" : " currmovenumber ", append(out, moveNumber);
+    out += jsonOutput ? "}\n" : "\n";
+
+    async_cout(out);
+}
+
+void SearchManager::bestmove(const Search::Worker& worker, Move best, Move ponderMove) {
+
+    bool chess960 = worker.rootPos.is_chess960();
+
+    out.clear();
+    out += worker.threads.tag;
+    out += jsonOutput ? "{\"bestmove\":\"" : "bestmove ";
+    out += UCI::move(best, chess960);
+
+    if (ponderMove != Move::none())
+    {
+        out += jsonOutput ? "\",\"ponder\":\"" : " ponder ";
+        out += UCI::move(ponderMove, chess960);
+    }
+
+    out += jsonOutput ? "\"}\n" : "\n";
+
+    async_cout(out);
+}
+
+// Sent after a search where some tablebase probes were skipped because the
+// table data was not in memory yet, see Tablebases::probe_wdl().
+void SearchManager::tb_probes(const Search::Worker& worker) {
+
+    out.clear();
+    out += worker.threads.tag;
+    out += jsonOutput ? "{\"tbprobes\":{\"resident\":" : "info string tbprobes resident ";
+    append(out, worker.threads.tb_hits());
+    out += jsonOutput ? ",\"cold\":" : " cold ";
+    append(out, worker.threads.tb_cold_probes());
+    out += jsonOutput ? "}}\n" : "\n";
+
+    async_cout(out);
+}
+
+// Sent when the root position is mate or stalemate
+void SearchManager::no_moves(const Search::Worker& worker) {
+
+    const Position& pos = worker.rootPos;
+    auto [unit, n]      = UCI::score_parts(pos.checkers() ? -VALUE_MATE : VALUE_DRAW, pos);
+
+    out.clear();
+    out += worker.threads.tag;
+    out += jsonOutput ? "{\"depth\":0,\"score\":{\"" : "info depth 0 score ";
+    out += unit;
+    out += jsonOutput ? "\":" : " ", append(out, n);
+    out += jsonOutput ? "}}\n" : "\n";
+
+    async_cout(out);
+}
+
+Search::SearchStats& Search::SearchStats::operator+=(const SearchStats& other) {
+
+    for (int d = 0; d < Depths; ++d)
+        for (int s = 0; s < STAT_NB; ++s)
+            counts[d][s] += other.counts[d][s];
+
+    return *this;
+}
+
+// Prints a table of the statistics by depth. The calls of search() and qsearch()
+// are a percentage of all the calls, the other counters are per 100 calls at
+// that depth, except fh-first which is the percentage of the fail highs on the
+// first move. Unlike the nodes of the search, the calls include the re-searches.
+// The cutoffs happen at most once per call, while the move prunes (fut-prn,
+// history and see) and the LMR searches happen per move and can exceed 100.
+void Search::SearchStats::print(std::ostream& os) const {
+
+    constexpr const char* Names[] = {"calls",   "tt-cut",  "razor",   "fut-cut",  "null",
+                                     "probcut", "fut-prn", "history", "see",      "lmr",
+                                     "re-srch", "fail-hi", "fh-first"};
+
+    static_assert(std::size(Names) == STAT_NB);
+
+    uint64_t total = 0;
+    for (auto& c : counts)
+        total += c[STAT_CALLS];
+
+    os << "\nSearch statistics (depth 0 is qsearch)\n\ndepth";
+    for (const char* name : Names)
+        os << std::setw(10) << name;
+    os << "\n";
+
+    auto percent = [](uint64_t part, uint64_t whole) {
+        return whole ? 100.0 * double(part) / double(whole) : 0.0;
+    };
+
+    for (int d = 0; d < Depths; ++d)
+    {
+        const auto& c = counts[d];
+
+        if (!c[STAT_CALLS])
+            continue;
+
+        os << std::setw(5) << d << std::fixed << std::setprecision(2) << std::setw(10)
+           << percent(c[STAT_CALLS], total);
 
-        ss << " nodes " << nodes << " nps " << nodes * 1000 / time << " hashfull " << tt.hashfull()
-           << " tbhits " << tbHits << " time " << time << " pv";
+        for (int s = STAT_TT_CUTOFF; s < STAT_FAIL_HIGH_FIRST; ++s)
+            os << std::setw(10) << percent(c[s], c[STAT_CALLS]);
 
-        for (Move m : rootMoves[i].pv)
-            ss << " " << UCI::move(m, pos.is_chess960());
+        os << std::setw(10) << percent(c[STAT_FAIL_HIGH_FIRST], c[STAT_FAIL_HIGH]) << "\n";
     }
 
-    return ss.str();
+    os << "\nCalls counted: " << total << std::endl;
 }
 
 // Called in case we have no ponder move before exiting the search,
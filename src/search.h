@@ -19,15 +19,19 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <iosfwd>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "cluster.h"
 #include "misc.h"
 #include "movepick.h"
 #include "position.h"
@@ -39,6 +43,7 @@ namespace Stockfish {
 
 namespace Eval::NNUE {
 struct Networks;
+struct EvalWorkspace;
 }
 
 // Different node types, used as a template parameter
@@ -54,6 +59,9 @@ class OptionsMap;
 
 namespace Search {
 
+constexpr int      NodesPublishPeriod = 1024;
+constexpr uint64_t NoNodeBudget       = std::numeric_limits<uint64_t>::max();
+
 // Stack struct keeps track of the information we need to remember from nodes
 // shallower and deeper in the tree during the search. Each search thread has
 // its own array of Stack objects, indexed by the current ply.
@@ -112,20 +120,53 @@ struct LimitsType {
     // Init explicitly due to broken value-initialization of non POD in MSVC
     LimitsType() {
         time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
-        movestogo = depth = mate = perft = infinite = 0;
-        nodes                                       = 0;
-        ponderMode                                  = false;
+        movestogo = depth = mate = perft = perftHash = infinite = 0;
+        nodes                                                   = 0;
+        ponderMode = perftStats                                 = false;
     }
 
     bool use_time_management() const { return time[WHITE] || time[BLACK]; }
 
     std::vector<Move> searchmoves;
     TimePoint         time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
-    int               movestogo, depth, mate, perft, infinite;
+    int               movestogo, depth, mate, perft, perftHash, infinite;
     uint64_t          nodes;
-    bool              ponderMode;
+    bool              ponderMode, perftStats;
+};
+
+
+// Counters of the calls of search() and qsearch() by depth, depth 0 being the
+// qsearch. They are only updated in builds with "make stats=yes", see
+// SEARCH_STAT(), and each worker writes its own counters. bench prints their
+// sum at the end.
+enum SearchStat {
+    STAT_CALLS,
+    STAT_TT_CUTOFF,
+    STAT_RAZORING,
+    STAT_FUTILITY_CUTOFF,
+    STAT_NULL_CUTOFF,
+    STAT_PROBCUT,
+    STAT_FUTILITY_PRUNE,
+    STAT_HISTORY_PRUNE,
+    STAT_SEE_PRUNE,
+    STAT_LMR,
+    STAT_RESEARCH,
+    STAT_FAIL_HIGH,
+    STAT_FAIL_HIGH_FIRST,
+    STAT_NB
 };
 
+struct SearchStats {
+    static constexpr int Depths = 32;
+
+    void add(SearchStat s, Depth d) { ++counts[std::clamp(d, 0, Depths - 1)][s]; }
+    void clear() { counts = {}; }
+    void print(std::ostream& os) const;
+
+    SearchStats& operator+=(const SearchStats& other);
+
+    std::array<std::array<uint64_t, STAT_NB>, Depths> counts{};
+};
 
 // The UCI stores the uci options, thread pool, and transposition table.
 // This struct is used to easily forward data to the Search::Worker class.
@@ -162,13 +203,22 @@ class SearchManager: public ISearchManager {
    public:
     void check_time(Search::Worker& worker) override;
 
-    std::string pv(const Search::Worker&     worker,
-                   const ThreadPool&         threads,
-                   const TranspositionTable& tt,
-                   Depth                     depth) const;
+    // Search output, formatted in a reused buffer and sent through async_cout()
+    void init_output(const OptionsMap& options);
+    void pv(const Search::Worker&     worker,
+            const ThreadPool&         threads,
+            const TranspositionTable& tt,
+            Depth                     depth,
+            bool                      force = false);
+    void currmove(const Search::Worker& worker, Depth depth, Move move, int moveNumber);
+    void bestmove(const Search::Worker& worker, Move best, Move ponderMove);
+    void no_moves(const Search::Worker& worker);
+    void tb_probes(const Search::Worker& worker);
+    void log_time(const Search::Worker& worker, Depth depth);
 
     Stockfish::TimeManagement tm;
     int                       callsCnt;
+    TimePoint                 lastInfoTime = now();  // Of the dbg_print() in check_time()
     std::atomic_bool          ponder;
 
     std::array<Value, 4> iterValue;
@@ -177,7 +227,16 @@ class SearchManager: public ISearchManager {
     Value                bestPreviousAverageScore;
     bool                 stopOnPonderhit;
 
+    // Time management telemetry of the current search, see log_time()
+    const char* stopReason;
+    TimePoint   targetTime;
+
     size_t id;
+
+    std::string out;
+    bool        jsonOutput;
+    TimePoint   infoInterval, lastInfo;
+    bool        infoPending;
 };
 
 class NullSearchManager: public ISearchManager {
@@ -192,10 +251,16 @@ class NullSearchManager: public ISearchManager {
 class Worker {
    public:
     Worker(SharedState&, std::unique_ptr<ISearchManager>, size_t);
+    ~Worker();
+
+    // Called by the owning thread before it first parks, so that the
+    // evaluation scratch memory is first touched on the thread's NUMA node.
+    void allocate_eval_workspace();
 
     // Called at instantiation to initialize Reductions tables
     // Reset histories, usually before a new game
     void clear();
+    void init_reductions();
 
     // Called when the program receives the UCI 'go' command.
     // It searches from the root position and outputs the "bestmove".
@@ -203,6 +268,9 @@ class Worker {
 
     bool is_mainthread() const { return thread_idx == 0; }
 
+    // Time since the start of the search, on the main thread only
+    TimePoint elapsed() const;
+
     // Public because they need to be updatable by the stats
     CounterMoveHistory    counterMoves;
     ButterflyHistory      mainHistory;
@@ -213,6 +281,7 @@ class Worker {
 
    private:
     void iterative_deepening();
+    void split_root_search();
 
     // Main search function for both PV and non-PV nodes
     template<NodeType nodeType>
@@ -224,6 +293,21 @@ class Worker {
 
     Depth reduction(bool i, Depth d, int mn, int delta);
 
+    // Counts a node. The counter has a single writer, so there is no need for
+    // an atomic increment. Every NodesPublishPeriod nodes the count is also
+    // published for the polling of the main thread.
+    void count_node() {
+        uint64_t n = nodes.load(std::memory_order_relaxed) + 1;
+        nodes.store(n, std::memory_order_relaxed);
+
+        if (n % NodesPublishPeriod == 0)
+            publishedNodes.store(n, std::memory_order_relaxed);
+    }
+
+    bool stopped() const;
+    bool aborted() const;
+    bool out_of_budget() const { return nodes.load(std::memory_order_relaxed) >= nodeBudget; }
+
     // Get a pointer to the search manager, only allowed to be called by the
     // main thread.
     SearchManager* main_manager() const {
@@ -233,9 +317,24 @@ class Worker {
 
     LimitsType limits;
 
-    size_t                pvIdx, pvLast;
-    std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
-    int                   selDepth, nmpMinPly;
+    // The share of limits.nodes of this thread with "Exact Nodes", see
+    // ThreadPool::start_thinking(). NoNodeBudget otherwise.
+    uint64_t nodeBudget = NoNodeBudget;
+
+    // Stand pat in qsearch on the PSQT estimate when it is far above beta,
+    // skipping the full network pass ("Lazy Stand Pat")
+    bool lazyStandPat = false;
+
+    size_t pvIdx, pvLast;
+
+    // The counters written by the search are on a cache line of their own, so
+    // that summing them from another thread does not slow down the accesses to
+    // the neighbouring fields. The published node count is on another line,
+    // which is written only once every NodesPublishPeriod nodes.
+    alignas(Eval::NNUE::CacheLineSize) std::atomic<uint64_t> nodes, tbHits, tbColdProbes,
+      bestMoveChanges, lazyEvals;
+    alignas(Eval::NNUE::CacheLineSize) std::atomic<uint64_t> publishedNodes;
+    alignas(Eval::NNUE::CacheLineSize) int selDepth, nmpMinPly;
 
     Value optimism[COLOR_NB];
 
@@ -255,11 +354,24 @@ class Worker {
 
     Tablebases::Config tbConfig;
 
+    SearchStats stats;
+
+    // Root split mode, see split_root_search()
+    bool      rootSplit = false;
+    RootMoves splitResults;
+
+    // Deep entries to be sent to the other ranks in cluster mode. The searches
+    // of the sessions are not part of the cluster.
+    Cluster::TTSendBuffer clusterBuffer;
+    bool                  clusterMember = false;
+
     const OptionsMap&           options;
     ThreadPool&                 threads;
     TranspositionTable&         tt;
     const Eval::NNUE::Networks& networks;
 
+    std::unique_ptr<Eval::NNUE::EvalWorkspace> evalWorkspace;
+
     friend class Stockfish::ThreadPool;
     friend class SearchManager;
 };
@@ -0,0 +1,72 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "session.h"
+
+#include <deque>
+
+#include "search.h"
+
+namespace Stockfish {
+
+// A session with hashMB == 0 shares sharedTT, otherwise it gets a private
+// table of that size. Its threads are placed after bindingOffset other search
+// threads of the process.
+Session::Session(const std::string&          sessionId,
+                 const OptionsMap&           options,
+                 const Eval::NNUE::Networks& networks,
+                 TranspositionTable&         sharedTT,
+                 size_t                      threadCount,
+                 size_t                      hashMB,
+                 size_t                      bindingOffset) :
+    id(sessionId),
+    ownTT(hashMB ? std::make_unique<TranspositionTable>() : nullptr),
+    tt(ownTT ? *ownTT : sharedTT),
+    states(new std::deque<StateInfo>(1)) {
+
+    threads.tag      = "session " + id + " ";
+    threads.sharedTT = !ownTT;
+    threads.set({options, threads, tt, networks}, threadCount, bindingOffset);
+
+    if (ownTT)
+        ownTT->resize(hashMB, int(threadCount));
+
+    clear();
+}
+
+
+// Stops a running search, pondering or infinite one included, before the
+// threads are destroyed.
+Session::~Session() {
+
+    threads.stop = true;
+    threads.main_thread()->wait_for_search_finished();
+}
+
+
+void Session::clear() {
+
+    threads.main_thread()->wait_for_search_finished();
+
+    if (ownTT)
+        ownTT->clear(threads.size());
+
+    threads.clear();
+}
+
+}  // namespace Stockfish
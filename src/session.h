@@ -0,0 +1,75 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SESSION_H_INCLUDED
+#define SESSION_H_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "position.h"
+#include "thread.h"
+#include "tt.h"
+
+namespace Stockfish {
+
+class OptionsMap;
+
+namespace Eval::NNUE {
+struct Networks;
+}
+
+// A search session has its own root position and search, served by its own
+// pool of threads, so that one process can run several analyses at the same
+// time. A session either owns a private transposition table or shares the one
+// of the engine, which it then leaves to the engine to age: its searches do not
+// start a new TT generation (see ThreadPool::sharedTT). Every line of its search
+// output starts with "session <id> ".
+class Session {
+   public:
+    Session(const std::string&          id,
+            const OptionsMap&           options,
+            const Eval::NNUE::Networks& networks,
+            TranspositionTable&         sharedTT,
+            size_t                      threadCount,
+            size_t                      hashMB,
+            size_t                      bindingOffset);
+    ~Session();
+
+    bool shares_tt() const { return !ownTT; }
+
+    // Waits for the current search and resets the histories and, when owned,
+    // the transposition table, as for a new game.
+    void clear();
+
+    const std::string id;
+
+   private:
+    std::unique_ptr<TranspositionTable> ownTT;
+
+   public:
+    TranspositionTable& tt;
+    ThreadPool          threads;
+    Position            pos;
+    StateListPtr        states;
+};
+
+}  // namespace Stockfish
+
+#endif  // #ifndef SESSION_H_INCLUDED
@@ -21,18 +21,26 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <deque>
-#include <fstream>
+#include <functional>
 #include <initializer_list>
+#include <iomanip>
 #include <iostream>
+#include <list>
 #include <mutex>
 #include <sstream>
 #include <string_view>
 #include <sys/stat.h>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -45,6 +53,7 @@
 #include "../ucioption.h"
 
 #ifndef _WIN32
+    #include <dirent.h>
     #include <fcntl.h>
     #include <sys/mman.h>
     #include <unistd.h>
@@ -187,43 +196,120 @@ static_assert(sizeof(LR) == 3, "LR tree entry must be 3 bytes");
 
 // class TBFile memory maps/unmaps the single .rtbw and .rtbz files. Files are
 // memory mapped for best performance. Files are mapped at first access: at init
-// time only existence of the file is checked.
-class TBFile: public std::ifstream {
+// time only existence of the file is checked, in the directory listings.
+class TBFile {
 
     std::string fname;
 
+#ifndef _WIN32
+    static constexpr char SepChar = ':';
+#else
+    static constexpr char SepChar = ';';
+#endif
+
+    // The file names are compared in lowercase, as they may be listed with
+    // another case than the one we look for on a case-insensitive filesystem.
+    static std::string lowercase(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(),
+                       [](unsigned char c) { return char(std::tolower(c)); });
+        return s;
+    }
+
+    // Names of the .rtbw and .rtbz files in the given directory
+    static std::vector<std::string> list(const std::string& dir) {
+
+        std::vector<std::string> names;
+
+        auto add = [&](const std::string& name) {
+            std::string ext = name.size() > 5 ? lowercase(name.substr(name.size() - 5)) : "";
+            if (ext == ".rtbw" || ext == ".rtbz")
+                names.push_back(name);
+        };
+
+#ifndef _WIN32
+        if (DIR* d = opendir(dir.c_str()))
+        {
+            while (dirent* e = readdir(d))
+                add(e->d_name);
+
+            closedir(d);
+        }
+#else
+        WIN32_FIND_DATAA data;
+        HANDLE           h = FindFirstFileA((dir + "\\*").c_str(), &data);
+
+        if (h != INVALID_HANDLE_VALUE)
+        {
+            do
+                add(data.cFileName);
+            while (FindNextFileA(h, &data));
+
+            FindClose(h);
+        }
+#endif
+        return names;
+    }
+
    public:
-    // Look for and open the file among the Paths directories where the .rtbw
-    // and .rtbz files can be found. Multiple directories are separated by ";"
-    // on Windows and by ":" on Unix-based operating systems.
+    // The Paths directories where the .rtbw and .rtbz files can be found.
+    // Multiple directories are separated by ";" on Windows and by ":" on
+    // Unix-based operating systems.
     //
     // Example:
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
     static std::string Paths;
 
-    TBFile(const std::string& f) {
+    // The path of each file found by scan(), by lowercase name
+    static std::unordered_map<std::string, std::string> Files;
 
-#ifndef _WIN32
-        constexpr char SepChar = ':';
-#else
-        constexpr char SepChar = ';';
-#endif
-        std::stringstream ss(Paths);
-        std::string       path;
+    // List the Paths directories once at init, instead of looking for each of
+    // the possible files in turn, that takes seconds on network storage. The
+    // directories are listed in parallel. A file found in more than one of them
+    // is taken from the first, in Paths order.
+    static void scan() {
+
+        std::stringstream        ss(Paths);
+        std::string              path;
+        std::vector<std::string> dirs;
 
         while (std::getline(ss, path, SepChar))
-        {
-            fname = path + "/" + f;
-            std::ifstream::open(fname);
-            if (is_open())
-                return;
-        }
+            dirs.push_back(path);
+
+        std::vector<std::vector<std::string>> names(dirs.size());
+        std::vector<std::thread>              threads;
+
+        for (size_t i = 0; i < dirs.size(); ++i)
+            threads.emplace_back([&, i]() { names[i] = list(dirs[i]); });
+
+        for (std::thread& th : threads)
+            th.join();
+
+        Files.clear();
+
+        for (size_t i = 0; i < dirs.size(); ++i)
+            for (const std::string& name : names[i])
+                Files.emplace(lowercase(name), dirs[i] + "/" + name);
+    }
+
+    // Open the file if it was found by scan()
+    // Whether the file was found by scan(), without opening it
+    static bool exists(const std::string& f) { return Files.count(lowercase(f)); }
+
+    // The path of the file found by scan(), empty if there is none. The file
+    // is only opened by map().
+    TBFile(const std::string& f) {
+
+        auto it = Files.find(lowercase(f));
+
+        if (it != Files.end())
+            fname = it->second;
     }
 
     // Memory map the file and check it.
     uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type) {
-        if (is_open())
-            close();  // Need to re-open to get native file descriptor
+
+        if (fname.empty())
+            return *baseAddress = nullptr, nullptr;
 
 #ifndef _WIN32
         struct stat statbuf;
@@ -313,7 +399,8 @@ class TBFile: public std::ifstream {
     }
 };
 
-std::string TBFile::Paths;
+std::string                                  TBFile::Paths;
+std::unordered_map<std::string, std::string> TBFile::Files;
 
 // struct PairsData contains low-level indexing information to access TB data.
 // There are 8, 4, or 2 PairsData records for each TBTable, according to the type
@@ -342,6 +429,11 @@ struct PairsData {
     uint16_t map_idx[4];              // WDLWin, WDLLoss, WDLCursedWin, WDLBlessedLoss (used in DTZ)
 };
 
+// Counters of the probes of a table made with the block cache enabled, times in ns
+struct ProbeStats {
+    std::atomic<uint64_t> hits{0}, misses{0}, hitTime{0}, missTime{0};
+};
+
 // struct TBTable contains indexing information to access the corresponding TBFile.
 // There are 2 types of TBTable, corresponding to a WDL or a DTZ file. TBTable
 // is populated at init time but the nested PairsData records are populated at
@@ -353,6 +445,8 @@ struct TBTable {
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
     std::atomic_bool ready;
+    std::atomic_bool mapQueued;  // Mapping left to the TBMapper thread
+    std::once_flag   mapOnce;
     void*            baseAddress;
     uint8_t*         map;
     uint64_t         mapping;
@@ -363,11 +457,14 @@ struct TBTable {
     bool             hasUniquePieces;
     uint8_t          pawnCount[2];     // [Lead color / other color]
     PairsData        items[Sides][4];  // [wtm / btm][FILE_A..FILE_D or 0]
+    std::string      name;             // Like "KRvK"
+    ProbeStats       stats;
 
     PairsData* get(int stm, int f) { return &items[stm % Sides][hasPawns ? f : 0]; }
 
     TBTable() :
         ready(false),
+        mapQueued(false),
         baseAddress(nullptr) {}
     explicit TBTable(const std::string& code);
     explicit TBTable(const TBTable<WDL>& wdl);
@@ -385,6 +482,7 @@ TBTable<WDL>::TBTable(const std::string& code) :
     StateInfo st;
     Position  pos;
 
+    name       = code;
     key        = pos.set(code, WHITE, &st).material_key();
     pieceCount = pos.count<ALL_PIECES>();
     hasPawns   = pos.pieces(PAWN);
@@ -411,6 +509,7 @@ TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) :
     TBTable() {
 
     // Use the corresponding WDL table to avoid recalculating all from scratch
+    name            = wdl.name;
     key             = wdl.key;
     key2            = wdl.key2;
     pieceCount      = wdl.pieceCount;
@@ -489,10 +588,83 @@ class TBTables {
     }
     size_t size() const { return wdlTable.size(); }
     void   add(const std::vector<PieceType>& pieces);
+
+    template<typename F>
+    void for_each(F f) {
+        for (auto& e : wdlTable)
+            f(e);
+        for (auto& e : dtzTable)
+            f(e);
+    }
 };
 
 TBTables TBTables;
 
+// class TBMapper maps, one after the other on a thread of its own, the tables
+// first probed by a search that must not wait for the disk, see probe_table(),
+// so that the search threads never open nor map a file themselves.
+class TBMapper {
+
+    std::mutex                        mutex;
+    std::condition_variable           cv;
+    std::deque<std::function<void()>> jobs;
+    std::thread                       th;
+    bool                              busy = false, exit = false;
+
+    void loop() {
+        std::unique_lock<std::mutex> lk(mutex);
+
+        while (true)
+        {
+            cv.wait(lk, [&] { return exit || !jobs.empty(); });
+
+            if (jobs.empty())
+                return;
+
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+
+            lk.unlock();
+            job();
+            lk.lock();
+
+            busy = false;
+            cv.notify_all();
+        }
+    }
+
+   public:
+    ~TBMapper() {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            exit = true;
+        }
+        cv.notify_all();
+
+        if (th.joinable())
+            th.join();
+    }
+
+    void push(std::function<void()> job) {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        if (!th.joinable())
+            th = std::thread(&TBMapper::loop, this);
+
+        jobs.push_back(std::move(job));
+        cv.notify_all();
+    }
+
+    // Waits for the queued mappings, before init() frees the tables
+    void wait() {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [&] { return jobs.empty() && !busy; });
+    }
+};
+
+TBMapper TBMapper;
+
 // If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
 // are created and added to the lists and hash table. Called at init time.
 void TBTables::add(const std::vector<PieceType>& pieces) {
@@ -502,13 +674,10 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
     for (PieceType pt : pieces)
         code += PieceToChar[pt];
 
-    TBFile file(code.insert(code.find('K', 1), "v") + ".rtbw");  // KRK -> KRvK
-
-    if (!file.is_open())  // Only WDL file is checked
+    // Only WDL file is checked
+    if (!TBFile::exists(code.insert(code.find('K', 1), "v") + ".rtbw"))  // KRK -> KRvK
         return;
 
-    file.close();
-
     MaxCardinality = std::max(int(pieces.size()), MaxCardinality);
 
     wdlTable.emplace_back(code);
@@ -534,11 +703,7 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
 // Huffman codes are the same for all blocks in the table. A non-symmetric pawnless TB file
 // will have one table for wtm and one for btm, a TB file with pawns will have tables per
 // file a,b,c,d also, in this case, one set for wtm and one for btm.
-int decompress_pairs(PairsData* d, uint64_t idx) {
-
-    // Special case where all table positions store the same value
-    if (d->flags & TBFlag::SingleValue)
-        return d->minSymLen;
+uint32_t find_block(PairsData* d, uint64_t idx, int* blockOffset) {
 
     // First we need to locate the right block that stores the value at index "idx".
     // Because each block n stores blockLength[n] + 1 values, the index i of the block
@@ -579,7 +744,15 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     while (offset > d->blockLength[block])
         offset -= d->blockLength[block++] + 1;
 
-    // Finally, we find the start address of our block of canonical Huffman symbols
+    *blockOffset = offset;
+    return block;
+}
+
+// Read the Huffman symbols at the start of the given block until the one that
+// contains the value at the given offset, then expand it to get the value.
+int decompress_block(PairsData* d, uint32_t block, int offset) {
+
+    // Find the start address of our block of canonical Huffman symbols
     uint32_t* ptr = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
 
     // Read the first 64 bits in our block, this is a (truncated) sequence of
@@ -650,6 +823,222 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     return d->btree[sym].get<LR::Left>();
 }
 
+// Decode all the values stored in the given block, for the block cache. Each
+// symbol is expanded depth first into its left and right child symbols, so the
+// values come out in the same order as their offsets.
+void expand_block(PairsData* d, uint32_t block, std::vector<Sym>& values) {
+
+    uint32_t* ptr   = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
+    uint64_t  buf64 = number<uint64_t, BigEndian>(ptr);
+    size_t    count = size_t(d->blockLength[block]) + 1;
+    int       buf64Size = 64;
+    Sym       stack[256];  // A symbol expands to at most 256 values
+
+    ptr += 2;
+    values.clear();
+    values.reserve(count);
+
+    while (true)
+    {
+        int len = 0;
+
+        while (buf64 < d->base64[len])
+            ++len;
+
+        Sym sym = Sym((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+        sym += number<Sym, LittleEndian>(&d->lowestSym[len]);
+
+        int top      = 0;
+        stack[top++] = sym;
+
+        while (top && values.size() < count)
+        {
+            sym = stack[--top];
+
+            if (!d->symlen[sym])
+                values.push_back(d->btree[sym].get<LR::Left>());
+            else
+            {
+                stack[top++] = d->btree[sym].get<LR::Right>();
+                stack[top++] = d->btree[sym].get<LR::Left>();
+            }
+        }
+
+        // Stop before the refill, that could read past the end of the last block
+        if (values.size() == count)
+            return;
+
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+
+        if (buf64Size <= 32)
+        {
+            buf64Size += 32;
+            buf64 |= uint64_t(number<uint32_t, BigEndian>(ptr++)) << (64 - buf64Size);
+        }
+    }
+}
+
+int decompress_pairs(PairsData* d, uint64_t idx) {
+
+    // Special case where all table positions store the same value
+    if (d->flags & TBFlag::SingleValue)
+        return d->minSymLen;
+
+    int      offset;
+    uint32_t block = find_block(d, idx, &offset);
+
+    return decompress_block(d, block, offset);
+}
+
+// class BlockCache keeps the values of recently expanded blocks, so that probing
+// again a position of a hot block is a lookup instead of a walk through the
+// Huffman symbols of the block. It is disabled until a size is set with the
+// SyzygyCacheSize option. Blocks are keyed by their PairsData record and index,
+// and evicted in LRU order when the memory cap is reached. The cache is split in
+// shards, each with its own lock, LRU list and share of the cap, so that the
+// search threads seldom wait for each other.
+class BlockCache {
+
+    using BlockKey = std::pair<const PairsData*, uint32_t>;
+
+    struct Block {
+        BlockKey         key;
+        std::vector<Sym> values;
+    };
+
+    struct KeyHash {
+        size_t operator()(const BlockKey& k) const {
+            return std::hash<const void*>()(k.first) ^ (size_t(k.second) * 0x9E3779B9);
+        }
+    };
+
+    struct Shard {
+        std::mutex                                                        mutex;
+        std::list<Block>                                                  lru;  // Most recent first
+        std::unordered_map<BlockKey, std::list<Block>::iterator, KeyHash> index;
+        size_t                                                            used = 0;
+    };
+
+    static constexpr size_t ShardsNb      = 16;
+    static constexpr size_t BlockOverhead = sizeof(Block) + 64;  // List and hash nodes
+
+    Shard               shards[ShardsNb];
+    std::atomic<size_t> capacity{0};  // In bytes, per shard
+
+    Shard& shard(const BlockKey& k) {
+        return shards[(k.second ^ (uintptr_t(k.first) >> 6)) % ShardsNb];
+    }
+    static size_t bytes(size_t valuesNb) { return BlockOverhead + valuesNb * sizeof(Sym); }
+    static size_t bytes(const Block& b) { return bytes(b.values.size()); }
+
+   public:
+    bool enabled() const { return capacity.load(std::memory_order_relaxed); }
+
+    void resize(size_t mbSize) {
+        clear();
+        capacity = mbSize * 1024 * 1024 / ShardsNb;
+    }
+
+    void clear() {
+        for (Shard& sh : shards)
+        {
+            std::scoped_lock<std::mutex> lk(sh.mutex);
+            sh.lru.clear();
+            sh.index.clear();
+            sh.used = 0;
+        }
+    }
+
+    // Return the value at the given offset of the block, setting 'hit' if the block
+    // was in the cache. Otherwise the block is expanded out of the lock and inserted,
+    // unless another thread did it in the meantime. A block bigger than the share
+    // of the cap of its shard is never cached, the value is decoded directly.
+    int probe(PairsData* d, uint32_t block, int offset, bool* hit) {
+
+        BlockKey key{d, block};
+        Shard&   sh   = shard(key);
+        size_t   size = bytes(size_t(d->blockLength[block]) + 1);
+
+        if (size > capacity.load(std::memory_order_relaxed))
+            return *hit = false, decompress_block(d, block, offset);
+
+        {
+            std::scoped_lock<std::mutex> lk(sh.mutex);
+
+            auto it = sh.index.find(key);
+            if ((*hit = it != sh.index.end()))
+            {
+                sh.lru.splice(sh.lru.begin(), sh.lru, it->second);
+                return it->second->values[offset];
+            }
+        }
+
+        Block b{key, {}};
+        expand_block(d, block, b.values);
+
+        int value = b.values[offset];
+
+        std::scoped_lock<std::mutex> lk(sh.mutex);
+
+        size_t cap = capacity.load(std::memory_order_relaxed);
+
+        if (size > cap || sh.index.count(key))
+            return value;
+
+        while (sh.used + size > cap)
+        {
+            sh.used -= bytes(sh.lru.back());
+            sh.index.erase(sh.lru.back().key);
+            sh.lru.pop_back();
+        }
+
+        sh.lru.push_front(std::move(b));
+        sh.index.emplace(key, sh.lru.begin());
+        sh.used += size;
+        return value;
+    }
+
+    // Number of blocks and bytes in the cache, and its cap in bytes
+    std::tuple<size_t, size_t, size_t> usage() {
+        size_t blocks = 0, used = 0;
+
+        for (Shard& sh : shards)
+        {
+            std::scoped_lock<std::mutex> lk(sh.mutex);
+            blocks += sh.lru.size();
+            used += sh.used;
+        }
+        return {blocks, used, capacity * ShardsNb};
+    }
+};
+
+BlockCache BlockCache;
+
+// Like decompress_pairs() above, but through the block cache, counting the hits
+// and the misses of the table with the time they took.
+int decompress_pairs(PairsData* d, uint64_t idx, ProbeStats& stats) {
+
+    if (d->flags & TBFlag::SingleValue)
+        return d->minSymLen;
+
+    auto start = std::chrono::steady_clock::now();
+
+    int      offset;
+    bool     hit;
+    uint32_t block = find_block(d, idx, &offset);
+    int      value = BlockCache.probe(d, block, offset, &hit);
+
+    uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count());
+
+    (hit ? stats.hits : stats.misses).fetch_add(1, std::memory_order_relaxed);
+    (hit ? stats.hitTime : stats.missTime).fetch_add(ns, std::memory_order_relaxed);
+    return value;
+}
+
 bool check_dtz_stm(TBTable<WDL>*, int, File) { return true; }
 
 bool check_dtz_stm(TBTable<DTZ>* entry, int stm, File f) {
@@ -701,6 +1090,59 @@ int map_score(TBTable<DTZ>* entry, File f, int value, WDLScore wdl) {
     #define CLANG_AVX512_BUG_FIX
 #endif
 
+// Check if the page holding addr is in memory, so that reading it cannot fault
+// to disk. If not, ask the kernel to read it in the background: a later probe
+// will then find it resident. Where this cannot be told, assume it is.
+bool resident(const void* addr) {
+
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+    static const uintptr_t PageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+
+    void* page = (void*) (uintptr_t(addr) & ~(PageSize - 1));
+    #ifdef __APPLE__
+    char vec;
+    #else
+    unsigned char vec;
+    #endif
+
+    if (mincore(page, PageSize, &vec) || (vec & 1))
+        return true;
+
+    madvise(page, PageSize, MADV_WILLNEED);
+    return false;
+#else
+    (void) addr;
+    return true;
+#endif
+}
+
+// Check the memory read by decompress_pairs() for the value at index idx: the
+// SparseIndex[] entry, then the blockLength[] entry and the block it points to.
+// The blocks stepped over when offset is out of range are usually on the same
+// pages and are not checked. All cold pages found are prefetched at once.
+bool resident(PairsData* d, uint64_t idx) {
+
+    if (d->flags & TBFlag::SingleValue)
+        return true;
+
+    SparseEntry* entry = &d->sparseIndex[idx / d->span];
+
+    // The 6 bytes of the entry can straddle two pages
+    bool entryHot = resident(entry);
+    entryHot &= resident(reinterpret_cast<uint8_t*>(entry + 1) - 1);
+
+    if (!entryHot)
+        return false;
+
+    uint32_t block = number<uint32_t, LittleEndian>(&entry->block);
+    uint8_t* ptr   = d->data + uint64_t(block) * d->sizeofBlock;
+
+    bool hot = resident(&d->blockLength[block]);
+    hot &= resident(ptr);
+    hot &= resident(ptr + d->sizeofBlock - 1);
+    return hot;
+}
+
 // Compute a unique index out of a position and use it to probe the TB file. To
 // encode k pieces of the same type and color, first sort the pieces by square in
 // ascending order s1 <= s2 <= ... <= sk then compute the unique index as:
@@ -709,7 +1151,7 @@ int map_score(TBTable<DTZ>* entry, File f, int value, WDLScore wdl) {
 //
 template<typename T, typename Ret = typename T::Ret>
 CLANG_AVX512_BUG_FIX Ret
-do_probe_table(const Position& pos, T* entry, WDLScore wdl, ProbeState* result) {
+do_probe_table(const Position& pos, T* entry, WDLScore wdl, ProbeState* result, bool wait) {
 
     Square     squares[TBPIECES];
     Piece      pieces[TBPIECES];
@@ -916,8 +1358,15 @@ encode_remaining:
         groupSq += d->groupLen[next];
     }
 
+    // A probe that must not wait for the disk gives up here if the data is cold
+    if (!wait && !resident(d, idx))
+        return *result = COLD, Ret();
+
     // Now that we have the index, decompress the pair and get the score
-    return map_score(entry, tbFile, decompress_pairs(d, idx), wdl);
+    int value = BlockCache.enabled() ? decompress_pairs(d, idx, entry->stats)
+                                     : decompress_pairs(d, idx);
+
+    return map_score(entry, tbFile, value, wdl);
 }
 
 // Group together pieces that will be encoded together. The general rule is that
@@ -1188,57 +1637,82 @@ void set(T& e, uint8_t* data) {
         }
 }
 
-// If the TB file corresponding to the given position is already memory-mapped
-// then return its base address, otherwise, try to memory map and init it. Called
-// at every probe, memory map, and init only at first access. Function is thread
-// safe and can be called concurrently.
+// Name of the file of the table e, like "KRvK.rtbw", with the stronger side
+// of pos first.
 template<TBType Type>
-void* mapped(TBTable<Type>& e, const Position& pos) {
-
-    static std::mutex mutex;
-
-    // Use 'acquire' to avoid a thread reading 'ready' == true while
-    // another is still working. (compiler reordering may cause this).
-    if (e.ready.load(std::memory_order_acquire))
-        return e.baseAddress;  // Could be nullptr if file does not exist
-
-    std::scoped_lock<std::mutex> lk(mutex);
-
-    if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
-        return e.baseAddress;
+std::string file_name(const TBTable<Type>& e, const Position& pos) {
 
     // Pieces strings in decreasing order for each color, like ("KPP","KR")
-    std::string fname, w, b;
+    std::string w, b;
     for (PieceType pt = KING; pt >= PAWN; --pt)
     {
         w += std::string(popcount(pos.pieces(WHITE, pt)), PieceToChar[pt]);
         b += std::string(popcount(pos.pieces(BLACK, pt)), PieceToChar[pt]);
     }
 
-    fname =
-      (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w) + (Type == WDL ? ".rtbw" : ".rtbz");
+    return (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w)
+         + (Type == WDL ? ".rtbw" : ".rtbz");
+}
+
+// Memory maps and inits the table e from the file fname, once. The threads
+// touching a table for the first time wait only on the once-flag of that table,
+// so that the first accesses to different tables, frequent when the search
+// enters an endgame, run in parallel.
+template<TBType Type>
+void* map_table(TBTable<Type>& e, const std::string& fname) {
+
+    std::call_once(e.mapOnce, [&]() {
+        uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
 
-    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+        if (data)
+            set(e, data);
 
-    if (data)
-        set(e, data);
+        e.ready.store(true, std::memory_order_release);
+    });
 
-    e.ready.store(true, std::memory_order_release);
     return e.baseAddress;
 }
 
+// If the TB file corresponding to the given position is already memory-mapped
+// then return its base address, otherwise, try to memory map and init it. Called
+// at every probe, memory map, and init only at first access. Function is thread
+// safe and can be called concurrently.
+template<TBType Type>
+void* mapped(TBTable<Type>& e, const Position& pos) {
+
+    // Use 'acquire' to avoid a thread reading 'ready' == true while
+    // another is still working. (compiler reordering may cause this).
+    if (e.ready.load(std::memory_order_acquire))
+        return e.baseAddress;  // Could be nullptr if file does not exist
+
+    return map_table(e, file_name(e, pos));
+}
+
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
-Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
+Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw, bool wait = true) {
 
     if (pos.count<ALL_PIECES>() == 2)  // KvK
         return Ret(WDLDraw);
 
     TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
 
-    if (!entry || !mapped(*entry, pos))
+    if (!entry)
+        return *result = FAIL, Ret();
+
+    // A probe that must not wait for the disk leaves the first mapping of the
+    // table to the TBMapper thread, and gives up until it is done
+    if (!wait && !entry->ready.load(std::memory_order_acquire))
+    {
+        if (!entry->mapQueued.exchange(true))
+            TBMapper.push([entry, fname = file_name(*entry, pos)]() { map_table(*entry, fname); });
+
+        return *result = COLD, Ret();
+    }
+
+    if (!mapped(*entry, pos))
         return *result = FAIL, Ret();
 
-    return do_probe_table(pos, entry, wdl, result);
+    return do_probe_table(pos, entry, wdl, result, wait);
 }
 
 // For a position where the side to move has a winning capture it is not necessary
@@ -1255,7 +1729,7 @@ Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw)
 // where the best move is an ep-move (even if losing). So in all these cases set
 // the state to ZEROING_BEST_MOVE.
 template<bool CheckZeroingMoves>
-WDLScore search(Position& pos, ProbeState* result) {
+WDLScore search(Position& pos, ProbeState* result, bool wait = true) {
 
     WDLScore  value, bestValue = WDLLoss;
     StateInfo st;
@@ -1271,10 +1745,10 @@ WDLScore search(Position& pos, ProbeState* result) {
         moveCount++;
 
         pos.do_move(move, st);
-        value = -search<false>(pos, result);
+        value = -search<false>(pos, result, wait);
         pos.undo_move(move);
 
-        if (*result == FAIL)
+        if (*result == FAIL || *result == COLD)
             return WDLDraw;
 
         if (value > bestValue)
@@ -1301,9 +1775,9 @@ WDLScore search(Position& pos, ProbeState* result) {
         value = bestValue;
     else
     {
-        value = probe_table<WDL>(pos, result);
+        value = probe_table<WDL>(pos, result, WDLDraw, wait);
 
-        if (*result == FAIL)
+        if (*result == FAIL || *result == COLD)
             return WDLDraw;
     }
 
@@ -1322,9 +1796,12 @@ WDLScore search(Position& pos, ProbeState* result) {
 // safe, nor it needs to be.
 void Tablebases::init(const std::string& paths) {
 
+    TBMapper.wait();     // Maps tables about to be freed
+    BlockCache.clear();  // Keyed by the PairsData records of the old tables
     TBTables.clear();
     MaxCardinality = 0;
     TBFile::Paths  = paths;
+    TBFile::Files.clear();
 
     if (paths.empty() || paths == "<empty>")
         return;
@@ -1423,6 +1900,8 @@ void Tablebases::init(const std::string& paths) {
             LeadPawnsSize[leadPawnsCnt][f] = idx;
         }
 
+    TBFile::scan();
+
     // Add entries in TB tables if the corresponding ".rtbw" file exists
     for (PieceType p1 = PAWN; p1 < KING; ++p1)
     {
@@ -1469,18 +1948,69 @@ void Tablebases::init(const std::string& paths) {
     sync_cout << "info string Found " << TBTables.size() << " tablebases" << sync_endl;
 }
 
+// Called at startup and after every change to "SyzygyCacheSize" UCI option, to
+// empty the block cache and set its cap. A size of zero disables the cache.
+void Tablebases::resize_cache(size_t mbSize) { BlockCache.resize(mbSize); }
+
+// Report the probes of each table made with the block cache enabled, the most
+// probed tables first, and the cache usage. Used by the 'tbstats' command.
+std::string Tablebases::probe_stats() {
+
+    struct Line {
+        std::string name;
+        uint64_t    hits, misses, hitTime, missTime;
+    };
+
+    std::vector<Line> lines;
+
+    TBTables.for_each([&](auto& e) {
+        uint64_t hits = e.stats.hits, misses = e.stats.misses;
+
+        if (hits + misses)
+            lines.push_back({e.name + (e.Sides == 2 ? ".rtbw" : ".rtbz"), hits, misses,
+                             e.stats.hitTime, e.stats.missTime});
+    });
+
+    std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) {
+        return a.hits + a.misses > b.hits + b.misses;
+    });
+
+    std::stringstream ss;
+
+    ss << std::left << std::setw(14) << "Table" << std::right << std::setw(12) << "Hits"
+       << std::setw(12) << "Misses" << std::setw(8) << "Hit %" << std::setw(10) << "Hit ns"
+       << std::setw(10) << "Miss ns" << '\n';
+
+    for (const Line& l : lines)
+        ss << std::left << std::setw(14) << l.name << std::right << std::setw(12) << l.hits
+           << std::setw(12) << l.misses << std::setw(8) << std::fixed << std::setprecision(1)
+           << 100.0 * l.hits / (l.hits + l.misses) << std::setw(10)
+           << (l.hits ? l.hitTime / l.hits : 0) << std::setw(10)
+           << (l.misses ? l.missTime / l.misses : 0) << '\n';
+
+    auto [blocks, used, cap] = BlockCache.usage();
+
+    ss << "Block cache: " << blocks << " blocks, " << std::fixed << std::setprecision(1)
+       << used / 1048576.0 << " of " << cap / 1048576.0 << " MB";
+
+    return ss.str();
+}
+
 // Probe the WDL table for a particular position.
 // If *result != FAIL, the probe was successful.
+// With wait == false the probe does not read table data that is not in memory:
+// it starts reading it in the background and returns with *result == COLD,
+// so that a search thread does not stall on the disk.
 // The return value is from the point of view of the side to move:
 // -2 : loss
 // -1 : loss, but draw under 50-move rule
 //  0 : draw
 //  1 : win, but draw under 50-move rule
 //  2 : win
-WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
+WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result, bool wait) {
 
     *result = OK;
-    return search<false>(pos, result);
+    return search<false>(pos, result, wait);
 }
 
 // Probe the DTZ table for a particular position.
@@ -1691,6 +2221,7 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
 
     config.rootInTB    = false;
     config.useRule50   = bool(options["Syzygy50MoveRule"]);
+    config.nonBlocking = bool(options["SyzygyNonBlocking"]);
     config.probeDepth  = int(options["SyzygyProbeDepth"]);
     config.cardinality = int(options["SyzygyProbeLimit"]);
 
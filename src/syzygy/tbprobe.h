@@ -19,6 +19,7 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -41,6 +42,7 @@ struct Config {
     int   cardinality = 0;
     bool  rootInTB    = false;
     bool  useRule50   = false;
+    bool  nonBlocking = false;
     Depth probeDepth  = 0;
 };
 
@@ -57,18 +59,21 @@ enum ProbeState {
     FAIL              = 0,   // Probe failed (missing file table)
     OK                = 1,   // Probe successful
     CHANGE_STM        = -1,  // DTZ should check the other side
-    ZEROING_BEST_MOVE = 2    // Best move zeroes DTZ (capture or pawn move)
+    ZEROING_BEST_MOVE = 2,   // Best move zeroes DTZ (capture or pawn move)
+    COLD              = -2   // Probe skipped, table data not in memory (see probe_wdl)
 };
 
 extern int MaxCardinality;
 
 
-void     init(const std::string& paths);
-WDLScore probe_wdl(Position& pos, ProbeState* result);
-int      probe_dtz(Position& pos, ProbeState* result);
-bool     root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-bool     root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-Config   rank_root_moves(const OptionsMap& options, Position& pos, Search::RootMoves& rootMoves);
+void        init(const std::string& paths);
+void        resize_cache(size_t mbSize);
+std::string probe_stats();
+WDLScore    probe_wdl(Position& pos, ProbeState* result, bool wait = true);
+int         probe_dtz(Position& pos, ProbeState* result);
+bool        root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50);
+bool        root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
+Config rank_root_moves(const OptionsMap& options, Position& pos, Search::RootMoves& rootMoves);
 
 }  // namespace Stockfish::Tablebases
 
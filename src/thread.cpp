@@ -22,9 +22,11 @@
 #include <cassert>
 #include <deque>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 
+#include "cluster.h"
 #include "misc.h"
 #include "movegen.h"
 #include "search.h"
@@ -36,14 +38,39 @@
 
 namespace Stockfish {
 
+namespace {
+
+// Number of times a waiting thread yields before it parks on its condition
+// variable, a few hundred microseconds on common hardware.
+constexpr int SpinIterations = 1024;
+
+// Returns the thread layout selected by the "Thread Binding" option
+std::string thread_binding(const OptionsMap& options) {
+
+    for (const char* layout : {"none", "compact", "spread", "nosmt"})
+        if (options["Thread Binding"] == layout)
+            return layout;
+
+    return "auto";
+}
+
+}  // namespace
+
 // Constructor launches the thread and waits until it goes to sleep
 // in idle_loop(). Note that 'searching' and 'exit' should be already set.
-Thread::Thread(Search::SharedState&                    sharedState,
-               std::unique_ptr<Search::ISearchManager> sm,
-               size_t                                  n) :
-    worker(std::make_unique<Search::Worker>(sharedState, std::move(sm), n)),
+// The thread is the n-th of its pool and is placed according to the "Thread
+// Binding" option as the bindingIndex-th of the totalThreads search threads
+// of the process.
+Thread::Thread(Search::SharedState&             sharedState,
+               std::unique_ptr<Search::Worker> w,
+               size_t                          n,
+               size_t                          totalThreads,
+               size_t                          bindingIndex) :
+    worker(std::move(w)),
     idx(n),
-    nthreads(sharedState.options["Threads"]),
+    nthreads(totalThreads),
+    bindingIdx(bindingIndex),
+    binding(thread_binding(sharedState.options)),
     stdThread(&Thread::idle_loop, this) {
 
     wait_for_search_finished();
@@ -62,101 +89,236 @@ Thread::~Thread() {
 }
 
 
-// Wakes up the thread that will start the search
+// Wakes up the thread that will start the search. The condition variable
+// is only notified when the thread has stopped spinning and is parked.
 void Thread::start_searching() {
     mutex.lock();
-    searching = true;
-    mutex.unlock();   // Unlock before notifying saves a few CPU-cycles
-    cv.notify_one();  // Wake up the thread in idle_loop()
+    searching  = true;
+    bool wake = parked;
+    mutex.unlock();  // Unlock before notifying saves a few CPU-cycles
+
+    if (wake)
+        cv.notify_one();  // Wake up the thread in idle_loop()
 }
 
 
-// Blocks on the condition variable
-// until the thread has finished searching.
+// Spins for a while, then blocks on the condition
+// variable until the thread has finished searching.
 void Thread::wait_for_search_finished() {
 
+    for (int i = 0; i < SpinIterations && searching; ++i)
+        std::this_thread::yield();
+
+    if (!searching)
+        return;
+
     std::unique_lock<std::mutex> lk(mutex);
     cv.wait(lk, [&] { return !searching; });
 }
 
 
-// Thread gets parked here, blocked on the
-// condition variable, when it has no work to do.
+// Thread spins here for a while and then gets parked, blocked on
+// the condition variable, when it has no work to do.
 
 void Thread::idle_loop() {
 
-    // If OS already scheduled us on a different group than 0 then don't overwrite
-    // the choice, eventually we are one of many one-threaded processes running on
-    // some Windows NUMA hardware, for instance in fishtest. To make it simple,
-    // just check if running threads are below a threshold, in this case, all this
-    // NUMA machinery is not needed.
-    if (nthreads > 8)
-        WinProcGroup::bind_this_thread(idx);
+    Affinity::bind_this_thread(bindingIdx, nthreads, binding);
+
+    worker->allocate_eval_workspace();
 
     while (true)
     {
-        std::unique_lock<std::mutex> lk(mutex);
+        mutex.lock();
         searching = false;
+        mutex.unlock();
         cv.notify_one();  // Wake up anyone waiting for search finished
-        cv.wait(lk, [&] { return searching; });
+
+        for (int i = 0; i < SpinIterations && !searching; ++i)
+            std::this_thread::yield();
+
+        if (!searching)
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            parked = true;
+            cv.wait(lk, [&] { return bool(searching); });
+            parked = false;
+        }
 
         if (exit)
             return;
 
-        lk.unlock();
-
         worker->start_searching();
     }
 }
 
+void WorkStealingQueue::reset(size_t itemCount, size_t consumerCount) {
+
+    if (slotCount != consumerCount)
+    {
+        slots     = std::make_unique<Slot[]>(consumerCount);
+        slotCount = consumerCount;
+    }
+
+    for (size_t i = 0; i < slotCount; ++i)
+        slots[i].items.clear();
+
+    for (size_t i = 0; i < itemCount; ++i)
+        slots[i % slotCount].items.push_back(i);
+}
+
+bool WorkStealingQueue::pop(size_t consumerIdx, size_t& itemIdx) {
+
+    for (size_t i = 0; i < slotCount; ++i)
+    {
+        Slot&                       slot = slots[(consumerIdx + i) % slotCount];
+        std::lock_guard<std::mutex> lk(slot.mutex);
+
+        if (slot.items.empty())
+            continue;
+
+        if (i == 0)  // Own deque
+            itemIdx = slot.items.front(), slot.items.pop_front();
+        else
+            itemIdx = slot.items.back(), slot.items.pop_back();
+
+        return true;
+    }
+
+    return false;
+}
+
 Search::SearchManager* ThreadPool::main_manager() {
     return static_cast<Search::SearchManager*>(main_thread()->worker.get()->manager.get());
 }
 
 uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
+
+// Whether the pool runs an infinite or pondering search, that only ends on a
+// stop or ponderhit sent by the caller.
+bool ThreadPool::waits_for_stop() {
+    return main_thread()->is_searching()
+        && (main_manager()->ponder || main_thread()->worker->limits.infinite);
+}
+
+// Cheaper node count for the polling of the main thread during the search:
+// exact for the main thread, and the counts published every NodesPublishPeriod
+// nodes for the others, so that their counters are not read while written.
+uint64_t ThreadPool::nodes_published() const {
+    return main_thread()->worker->nodes.load(std::memory_order_relaxed)
+         - main_thread()->worker->publishedNodes.load(std::memory_order_relaxed)
+         + accumulate(&Search::Worker::publishedNodes);
+}
 uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+uint64_t ThreadPool::tb_cold_probes() const { return accumulate(&Search::Worker::tbColdProbes); }
+uint64_t ThreadPool::lazy_evals() const { return accumulate(&Search::Worker::lazyEvals); }
 
-// Creates/destroys threads to match the requested number.
-// Created and launched threads will immediately go to sleep in idle_loop.
-// Upon resizing, threads are recreated to allow for binding if necessary.
-void ThreadPool::set(Search::SharedState sharedState) {
+// Sums the search statistics of the threads, to be called between searches
+Search::SearchStats ThreadPool::search_stats() const {
 
-    if (threads.size() > 0)  // destroy any existing thread(s)
-    {
+    Search::SearchStats sum;
+
+    for (Thread* th : threads)
+        sum += th->worker->stats;
+
+    return sum;
+}
+
+// Returns the worker of the idx-th thread: a spare one when available, with
+// its histories and allocations, or a new one otherwise.
+std::unique_ptr<Search::Worker> ThreadPool::make_worker(Search::SharedState& sharedState,
+                                                        size_t               idx) {
+
+    if (spareWorkers.empty())
+        return std::make_unique<Search::Worker>(
+          sharedState,
+          idx ? std::unique_ptr<Search::ISearchManager>(new Search::NullSearchManager())
+              : std::unique_ptr<Search::ISearchManager>(new Search::SearchManager()),
+          idx);
+
+    std::unique_ptr<Search::Worker> w = std::move(spareWorkers.back());
+    spareWorkers.pop_back();
+
+    // Only the main thread has a real SearchManager
+    if (!idx != w->is_mainthread())
+        w->manager = idx ? std::unique_ptr<Search::ISearchManager>(new Search::NullSearchManager())
+                         : std::unique_ptr<Search::ISearchManager>(new Search::SearchManager());
+
+    w->thread_idx = idx;
+    return w;
+}
+
+// Grows or shrinks the pool to the requested number of threads. Created and
+// launched threads will immediately go to sleep in idle_loop. The threads that
+// are kept keep their histories, and the workers of the removed threads are
+// kept aside, up to the requested number, and reused when the pool grows
+// again. All threads are recreated
+// when their binding changes, bindingOffset being the number of search threads
+// of the process placed before this pool. The transposition table is left
+// untouched.
+void ThreadPool::set(Search::SharedState sharedState, size_t requested, size_t offset) {
+
+    const std::string layout = thread_binding(sharedState.options);
+    const bool        rebind = layout != binding || offset != bindingOffset;
+
+    if (threads.size() > 0)
         main_thread()->wait_for_search_finished();
 
-        while (threads.size() > 0)
-            delete threads.back(), threads.pop_back();
+    // Remove threads from the back, keeping their workers
+    while (threads.size() > (rebind ? 0 : requested))
+    {
+        Thread* th = threads.back();
+        spareWorkers.push_back(std::move(th->worker));
+        delete th, threads.pop_back();
     }
 
-    const size_t requested = sharedState.options["Threads"];
+    // Free the spares removed first, the last ones are reused first
+    if (spareWorkers.size() > requested)
+        spareWorkers.erase(spareWorkers.begin(),
+                           spareWorkers.begin() + (spareWorkers.size() - requested));
 
-    if (requested > 0)  // create new thread(s)
-    {
-        threads.push_back(new Thread(
-          sharedState, std::unique_ptr<Search::ISearchManager>(new Search::SearchManager()), 0));
+    const bool newMain = threads.empty();
 
+    // The saved root was searched with another pool, do not seed the next search
+    lastRootValid = false;
 
-        while (threads.size() < requested)
-            threads.push_back(new Thread(
-              sharedState, std::unique_ptr<Search::ISearchManager>(new Search::NullSearchManager()),
-              threads.size()));
-        clear();
+    binding       = layout;
+    bindingOffset = offset;
 
-        main_thread()->wait_for_search_finished();
+    while (threads.size() < requested)
+        threads.push_back(new Thread(sharedState, make_worker(sharedState, threads.size()),
+                                     threads.size(), offset + requested,
+                                     offset + threads.size()));
 
-        // Reallocate the hash with the new threadpool size
-        sharedState.tt.resize(sharedState.options["Hash"], requested);
+    // The reductions depend on the number of threads
+    for (Thread* th : threads)
+        th->worker->init_reductions();
+
+    if (threads.size() > 0)
+    {
+        if (newMain)
+        {
+            main_manager()->callsCnt                 = 0;
+            main_manager()->bestPreviousScore        = VALUE_INFINITE;
+            main_manager()->bestPreviousAverageScore = VALUE_INFINITE;
+            main_manager()->previousTimeReduction    = 1.0;
+            main_manager()->tm.clear();
+        }
+
+        main_thread()->wait_for_search_finished();
     }
 }
 
-
-// Sets threadPool data to initial values
+// Sets threadPool data to initial values. The spare workers are freed, so
+// that no history of an earlier game comes back when the pool grows.
 void ThreadPool::clear() {
 
     for (Thread* th : threads)
         th->worker->clear();
 
+    spareWorkers.clear();
+
+    lastRootValid = false;
+
     main_manager()->callsCnt                 = 0;
     main_manager()->bestPreviousScore        = VALUE_INFINITE;
     main_manager()->bestPreviousAverageScore = VALUE_INFINITE;
@@ -186,8 +348,21 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
             || std::count(limits.searchmoves.begin(), limits.searchmoves.end(), m))
             rootMoves.emplace_back(m);
 
+    reuse_last_root(pos, rootMoves);
+
     Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
 
+    // In root split mode, each root move is searched on its own to the target
+    // depth by one of the threads, which take them from splitQueue.
+    const bool rootSplit = options["Root Split"] && limits.depth && int(options["MultiPV"]) > 1
+                        && rootMoves.size() > 1;
+
+    if (rootSplit)
+    {
+        splitMoves = rootMoves;
+        splitQueue.reset(rootMoves.size(), size());
+    }
+
     // After ownership transfer 'states' becomes empty, so if we stop the search
     // and call 'go' again without setting a new position states.get() == nullptr.
     assert(states.get() || setupStates.get());
@@ -195,26 +370,157 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     if (states.get())
         setupStates = std::move(states);  // Ownership transfer, states is now empty
 
-    // We use Position::set() to set root position across threads. But there are
-    // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-    // be deduced from a fen string, so set() clears them and they are set from
-    // setupStates->back() later. The rootState is per thread, earlier states are shared
+    // The root position is copied to every thread together with its state,
+    // setupStates->back(). The rootState is per thread, earlier states are shared
     // since they are read-only.
+    // With "Exact Nodes" the node limit is split evenly between the threads,
+    // each one searching exactly its share instead of all of them racing to
+    // the global count. The cost of a search is then known in advance.
+    const bool exactNodes   = options["Exact Nodes"] && limits.nodes;
+    const bool lazyStandPat = options["Lazy Stand Pat"];
+
     for (Thread* th : threads)
     {
-        th->worker->limits = limits;
-        th->worker->nodes = th->worker->tbHits = th->worker->nmpMinPly =
-          th->worker->bestMoveChanges          = 0;
+        size_t idx = th->worker->thread_idx;
+
+        th->worker->limits     = limits;
+        th->worker->nodeBudget = exactNodes ? limits.nodes / size() + (idx < limits.nodes % size())
+                                            : Search::NoNodeBudget;
+        th->worker->nodes = th->worker->publishedNodes = th->worker->tbHits =
+          th->worker->tbColdProbes = th->worker->lazyEvals = th->worker->nmpMinPly =
+            th->worker->bestMoveChanges = 0;
         th->worker->rootDepth = th->worker->completedDepth = 0;
         th->worker->rootMoves                              = rootMoves;
-        th->worker->rootPos.set(pos.fen(), pos.is_chess960(), &th->worker->rootState);
+        th->worker->rootSplit                              = rootSplit;
+        th->worker->lazyStandPat                           = lazyStandPat;
+        th->worker->splitResults.clear();
+#ifdef SEARCH_STATS
+        th->worker->stats.clear();
+#endif
         th->worker->rootState = setupStates->back();
-        th->worker->tbConfig  = tbConfig;
+        th->worker->rootPos.set(pos, &th->worker->rootState);
+        th->worker->tbConfig      = tbConfig;
+        th->worker->clusterMember = Cluster::size() > 1 && tag.empty();
     }
 
+    lastRootValid = true;
     main_thread()->start_searching();
 }
 
+// Carries the results of the last search over to the new one when the new root
+// is the same position, a child or the parent of the last root, as when stepping
+// through a game in analysis. The root moves are ordered after the last search
+// and the expected best move gets the last score and PV, so the aspiration
+// windows start around the known score and a PV is ready before the first
+// iteration completes. The histories are kept between searches anyway.
+void ThreadPool::reuse_last_root(Position& pos, Search::RootMoves& rootMoves) {
+
+    Search::Worker& last = *main_thread()->worker;
+
+    if (!lastRootValid || rootMoves.empty() || last.rootMoves.empty()
+        || last.rootMoves[0].pv[0] == Move::none())
+        return;
+
+    const Search::RootMove& best = last.rootMoves[0];
+    StateInfo               st;
+
+    // Gives the root move the score, seen from the new root, and the PV. Mate
+    // and TB scores depend on the ply, so they only set the order.
+    auto seed = [](Search::RootMove& rm, const Search::RootMove& from, bool negate,
+                   std::vector<Move> pv) {
+        if (from.score == -VALUE_INFINITE || std::abs(from.score) >= VALUE_TB_WIN_IN_MAX_PLY)
+            return;
+
+        rm.score = rm.previousScore = rm.uciScore = negate ? -from.score : from.score;
+        rm.averageScore = from.averageScore == -VALUE_INFINITE ? rm.score
+                        : negate                               ? -from.averageScore
+                                                               : from.averageScore;
+        rm.pv           = std::move(pv);
+    };
+
+    // The score of the last search, used by the time management, changes side
+    auto flip_previous_score = [&]() {
+        Search::SearchManager* sm = main_manager();
+        if (sm->bestPreviousScore != VALUE_INFINITE)
+            sm->bestPreviousScore = -sm->bestPreviousScore;
+        if (sm->bestPreviousAverageScore != VALUE_INFINITE)
+            sm->bestPreviousAverageScore = -sm->bestPreviousAverageScore;
+    };
+
+    auto to_front = [&](Move m) {
+        auto it = std::find(rootMoves.begin(), rootMoves.end(), m);
+        if (it != rootMoves.end())
+            std::rotate(rootMoves.begin(), it, it + 1);
+        return it != rootMoves.end() ? &rootMoves[0] : nullptr;
+    };
+
+    // The same root: the order and scores of all the moves are kept
+    if (pos.key() == last.rootPos.key())
+    {
+        for (auto lrm = last.rootMoves.rbegin(); lrm != last.rootMoves.rend(); ++lrm)
+            if (Search::RootMove* rm = to_front(lrm->pv[0]))
+                seed(*rm, *lrm, false, lrm->pv);
+        return;
+    }
+
+    // A child of the last root, the expected reply comes first
+    for (const Search::RootMove& lrm : last.rootMoves)
+    {
+        last.rootPos.do_move(lrm.pv[0], st);
+        bool child = last.rootPos.key() == pos.key();
+        last.rootPos.undo_move(lrm.pv[0]);
+
+        if (!child)
+            continue;
+
+        if (lrm.pv.size() > 1)
+            if (Search::RootMove* rm = to_front(lrm.pv[1]))
+                seed(*rm, lrm, true, std::vector<Move>(lrm.pv.begin() + 1, lrm.pv.end()));
+
+        flip_previous_score();
+        return;
+    }
+
+    // The parent of the last root, the move leading to it comes first
+    for (const Search::RootMove& rm : rootMoves)
+    {
+        Move m = rm.pv[0];
+
+        pos.do_move(m, st);
+        bool parent = pos.key() == last.rootPos.key();
+        pos.undo_move(m);
+
+        if (!parent)
+            continue;
+
+        std::vector<Move> pv{m};
+        pv.insert(pv.end(), best.pv.begin(), best.pv.end());
+        seed(*to_front(m), best, true, pv);
+        flip_previous_score();
+        return;
+    }
+}
+
+// Gathers the root moves searched by all the threads in root split mode,
+// best first.
+Search::RootMoves ThreadPool::split_results() const {
+
+    Search::RootMoves merged;
+
+    for (Thread* th : threads)
+        merged.insert(merged.end(), th->worker->splitResults.begin(),
+                      th->worker->splitResults.end());
+
+    std::stable_sort(merged.begin(), merged.end());
+    return merged;
+}
+
+const Search::RootMove& ThreadPool::best_root_move() const {
+    return main_thread()->worker->rootMoves[0];
+}
+
+Depth ThreadPool::completed_depth() const { return main_thread()->worker->completedDepth; }
+
 Thread* ThreadPool::get_best_thread() const {
 
     Thread* bestThread = threads.front();
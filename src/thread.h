@@ -23,8 +23,10 @@
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "position.h"
@@ -42,14 +44,21 @@ using Value = int;
 // waiting for a signal to start searching.
 // When the signal is received, the thread starts searching and when
 // the search is finished, it goes back to idle_loop() waiting for a new signal.
+// Waiting first spins for a short while and only then parks the thread on the
+// condition variable, so that back-to-back short searches avoid kernel wakeups.
 class Thread {
    public:
-    Thread(Search::SharedState&, std::unique_ptr<Search::ISearchManager>, size_t);
+    Thread(Search::SharedState&,
+           std::unique_ptr<Search::Worker>,
+           size_t n,
+           size_t totalThreads,
+           size_t bindingIndex);
     virtual ~Thread();
 
     void   idle_loop();
     void   start_searching();
     void   wait_for_search_finished();
+    bool   is_searching() const { return searching; }
     size_t id() const { return idx; }
 
     std::unique_ptr<Search::Worker> worker;
@@ -57,12 +66,34 @@ class Thread {
    private:
     std::mutex              mutex;
     std::condition_variable cv;
-    size_t                  idx, nthreads;
-    bool                    exit = false, searching = true;  // Set before starting std::thread
+    size_t                  idx, nthreads, bindingIdx;
+    std::string             binding;
+    std::atomic_bool        searching = true;  // Set before starting std::thread
+    bool                    exit = false, parked = false;
     NativeThread            stdThread;
 };
 
 
+// Work-stealing queue of the indices of work items, the root moves searched in
+// root split mode or the positions of a batch analysis. The items are dealt to
+// the consumers in turn. Each one takes the items from the front of its own
+// deque and, when it is empty, steals from the back of the others.
+class WorkStealingQueue {
+   public:
+    void reset(size_t itemCount, size_t consumerCount);
+    bool pop(size_t consumerIdx, size_t& itemIdx);
+
+   private:
+    struct Slot {
+        std::mutex         mutex;
+        std::deque<size_t> items;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t                  slotCount = 0;
+};
+
+
 // ThreadPool struct handles all the threads-related stuff like init, starting,
 // parking and, most importantly, launching a thread. All the access to threads
 // is done through this class.
@@ -82,18 +113,44 @@ class ThreadPool {
 
     void start_thinking(const OptionsMap&, Position&, StateListPtr&, Search::LimitsType);
     void clear();
-    void set(Search::SharedState);
+    void set(Search::SharedState, size_t requested, size_t bindingOffset = 0);
 
     Search::SearchManager* main_manager();
     Thread*                main_thread() const { return threads.front(); }
     uint64_t               nodes_searched() const;
+    uint64_t               nodes_published() const;
     uint64_t               tb_hits() const;
+    uint64_t               tb_cold_probes() const;
+    uint64_t               lazy_evals() const;
+    Search::SearchStats    search_stats() const;
     Thread*                get_best_thread() const;
+    Search::RootMoves      split_results() const;
+
+    // Result of the last search, for a pool of a single thread
+    const Search::RootMove& best_root_move() const;
+    Depth                   completed_depth() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
+    bool                   waits_for_stop();
 
     std::atomic_bool stop, abortedSearch, increaseDepth;
 
+    // Prefix of every line of search output, so that the output of concurrent
+    // search sessions can be told apart. Empty for the main engine pool.
+    std::string tag;
+
+    // No search output at all, for callers reading the results with
+    // best_root_move() instead
+    bool quiet = false;
+
+    // The transposition table is also used by other concurrent searches, see
+    // Session. Only the owner of the table starts a new generation.
+    bool sharedTT = false;
+
+    // In root split mode, all the root moves and the queue of the ones left
+    Search::RootMoves splitMoves;
+    WorkStealingQueue splitQueue;
+
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
     auto end() noexcept { return threads.end(); }
@@ -105,6 +162,19 @@ class ThreadPool {
     StateListPtr         setupStates;
     std::vector<Thread*> threads;
 
+    // Workers of the threads removed by set(), reused when the pool grows
+    // again, at most as many as the threads kept, and the binding the current
+    // threads were placed with
+    std::vector<std::unique_ptr<Search::Worker>> spareWorkers;
+    std::string                                  binding;
+    size_t                                       bindingOffset = 0;
+
+    std::unique_ptr<Search::Worker> make_worker(Search::SharedState&, size_t idx);
+
+    // Whether the main worker still holds the root of the last search
+    bool lastRootValid = false;
+    void reuse_last_root(Position& pos, Search::RootMoves& rootMoves);
+
     uint64_t accumulate(std::atomic<uint64_t> Search::Worker::*member) const {
 
         uint64_t sum = 0;
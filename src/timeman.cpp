@@ -22,6 +22,8 @@
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <iostream>
+#include <sstream>
 
 #include "search.h"
 #include "ucioption.h"
@@ -30,9 +32,6 @@ namespace Stockfish {
 
 TimePoint TimeManagement::optimum() const { return optimumTime; }
 TimePoint TimeManagement::maximum() const { return maximumTime; }
-TimePoint TimeManagement::elapsed(size_t nodes) const {
-    return useNodesTime ? TimePoint(nodes) : now() - startTime;
-}
 
 void TimeManagement::clear() {
     availableNodes = 0;  // When in 'nodes as time' mode
@@ -129,4 +128,56 @@ void TimeManagement::init(Search::LimitsType& limits,
         optimumTime += optimumTime / 4;
 }
 
+// Writes the record as a single line of "key value" pairs
+std::ostream& operator<<(std::ostream& os, const TimeRecord& r) {
+
+    os << "ply " << r.ply << " time " << r.time << " inc " << r.inc << " movestogo "
+       << r.movestogo << " overhead " << r.overhead << " optimum " << r.optimum << " maximum "
+       << r.maximum << " target " << r.target << " actual " << r.actual << " depth " << r.depth
+       << " stop " << r.stop;
+
+    return os;
+}
+
+// Reads a record from the next line. Unknown keys are skipped, so that the
+// log can grow new fields without breaking older readers.
+std::istream& operator>>(std::istream& is, TimeRecord& r) {
+
+    std::string line, key;
+
+    if (!std::getline(is, line))
+        return is;
+
+    std::istringstream ss(line);
+    r = TimeRecord();
+
+    while (ss >> key)
+        if (key == "ply")
+            ss >> r.ply;
+        else if (key == "time")
+            ss >> r.time;
+        else if (key == "inc")
+            ss >> r.inc;
+        else if (key == "movestogo")
+            ss >> r.movestogo;
+        else if (key == "overhead")
+            ss >> r.overhead;
+        else if (key == "optimum")
+            ss >> r.optimum;
+        else if (key == "maximum")
+            ss >> r.maximum;
+        else if (key == "target")
+            ss >> r.target;
+        else if (key == "actual")
+            ss >> r.actual;
+        else if (key == "depth")
+            ss >> r.depth;
+        else if (key == "stop")
+            ss >> r.stop;
+        else
+            ss >> key;
+
+    return is;
+}
+
 }  // namespace Stockfish
@@ -21,6 +21,8 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <iosfwd>
+#include <string>
 
 #include "misc.h"
 #include "types.h"
@@ -41,7 +43,11 @@ class TimeManagement {
 
     TimePoint optimum() const;
     TimePoint maximum() const;
-    TimePoint elapsed(std::size_t nodes) const;
+    // The node count is only computed in 'nodes as time' mode
+    template<typename FUNC>
+    TimePoint elapsed(FUNC nodes) const {
+        return useNodesTime ? TimePoint(nodes()) : now() - startTime;
+    }
 
     void clear();
     void advance_nodes_time(std::int64_t nodes);
@@ -55,6 +61,27 @@ class TimeManagement {
     bool         useNodesTime   = false;  // True if we are in 'nodes as time' mode
 };
 
+// One line of the "Time Log": the clock given to TimeManagement::init() for a
+// move, the time bounds it computed, the target after the scaling done by the
+// iterative deepening, and how long the search actually took and why it
+// stopped. The 'replay' command feeds the logged clocks back to init().
+struct TimeRecord {
+    int         ply       = 0;
+    TimePoint   time      = 0;
+    TimePoint   inc       = 0;
+    int         movestogo = 0;
+    TimePoint   overhead  = 0;
+    TimePoint   optimum   = 0;
+    TimePoint   maximum   = 0;
+    TimePoint   target    = 0;
+    TimePoint   actual    = 0;
+    Depth       depth     = 0;
+    std::string stop;
+};
+
+std::ostream& operator<<(std::ostream& os, const TimeRecord& r);
+std::istream& operator>>(std::istream& is, TimeRecord& r);
+
 }  // namespace Stockfish
 
 #endif  // #ifndef TIMEMAN_H_INCLUDED
@@ -127,15 +127,15 @@ TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
             constexpr uint8_t lowerBits = GENERATION_DELTA - 1;
 
             // Refresh with new generation, keeping the lower bits the same.
-            tte[i].genBound8 = uint8_t(generation8 | (tte[i].genBound8 & lowerBits));
+            tte[i].genBound8 = uint8_t(generation() | (tte[i].genBound8 & lowerBits));
             return found     = bool(tte[i].depth8), &tte[i];
         }
 
     // Find an entry to be replaced according to the replacement strategy
     TTEntry* replace = tte;
     for (int i = 1; i < ClusterSize; ++i)
-        if (replace->depth8 - replace->relative_age(generation8) * 2
-            > tte[i].depth8 - tte[i].relative_age(generation8) * 2)
+        if (replace->depth8 - replace->relative_age(generation()) * 2
+            > tte[i].depth8 - tte[i].relative_age(generation()) * 2)
             replace = &tte[i];
 
     return found = false, replace;
@@ -151,7 +151,7 @@ int TranspositionTable::hashfull() const {
     for (int i = 0; i < 1000; ++i)
         for (int j = 0; j < ClusterSize; ++j)
             cnt += table[i].entry[j].depth8
-                && (table[i].entry[j].genBound8 & GENERATION_MASK) == generation8;
+                && (table[i].entry[j].genBound8 & GENERATION_MASK) == generation();
 
     return cnt / ClusterSize;
 }
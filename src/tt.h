@@ -19,6 +19,7 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 
@@ -94,7 +95,7 @@ class TranspositionTable {
 
     void new_search() {
         // increment by delta to keep lower bits as is
-        generation8 += GENERATION_DELTA;
+        generation8.fetch_add(GENERATION_DELTA, std::memory_order_relaxed);
     }
 
     TTEntry* probe(const Key key, bool& found) const;
@@ -106,14 +107,17 @@ class TranspositionTable {
         return &table[mul_hi64(key, clusterCount)].entry[0];
     }
 
-    uint8_t generation() const { return generation8; }
+    uint8_t generation() const { return generation8.load(std::memory_order_relaxed); }
 
    private:
     friend struct TTEntry;
 
     size_t   clusterCount;
-    Cluster* table       = nullptr;
-    uint8_t  generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
+    Cluster* table = nullptr;
+
+    // Read by the searches sharing the table while another one starts a new
+    // generation. Size must be not bigger than TTEntry::genBound8.
+    std::atomic<uint8_t> generation8 = 0;
 };
 
 }  // namespace Stockfish
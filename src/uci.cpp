@@ -19,19 +19,25 @@
 #include "uci.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <deque>
+#include <fstream>
+#include <iomanip>
 #include <memory>
 #include <optional>
 #include <sstream>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "benchmark.h"
+#include "cluster.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "nnue/network.h"
@@ -40,6 +46,7 @@
 #include "position.h"
 #include "search.h"
 #include "syzygy/tbprobe.h"
+#include "timeman.h"
 #include "types.h"
 #include "ucioption.h"
 
@@ -56,22 +63,36 @@ UCI::UCI(int argc, char** argv) :
     networks(NN::Networks(
       NN::NetworkBig({EvalFileDefaultNameBig, "None", ""}, NN::EmbeddedNNUEType::BIG),
       NN::NetworkSmall({EvalFileDefaultNameSmall, "None", ""}, NN::EmbeddedNNUEType::SMALL))),
-    cli(argc, argv) {
+    cli(argc, argv),
+    evalWorkspace(std::make_unique<NN::EvalWorkspace>()) {
 
     options["Debug Log File"] << Option("", [](const Option& o) { start_logger(o); });
 
-    options["Threads"] << Option(1, 1, 1024, [this](const Option&) {
-        threads.set({options, threads, tt, networks});
+    options["Threads"] << Option(1, 1, 1024, [this](const Option& o) {
+        threads.set({options, threads, tt, networks}, size_t(o));
     });
 
+    options["Thread Binding"] << Option("auto var auto var none var compact var spread var nosmt",
+                                        "auto", [this](const Option&) {
+                                            threads.set({options, threads, tt, networks},
+                                                        size_t(options["Threads"]));
+                                        });
+
+    options["SMP Depth Skipping"] << Option(false);
+    options["SMP Root Perturbation"] << Option(false);
+    options["SMP Aspiration Spread"] << Option(0, 0, 100);
+
     options["Hash"] << Option(16, 1, MaxHashMB, [this](const Option& o) {
-        threads.main_thread()->wait_for_search_finished();
+        wait_for_shared_tt();
         tt.resize(o, options["Threads"]);
     });
 
     options["Clear Hash"] << Option([this](const Option&) { search_clear(); });
     options["Ponder"] << Option(false);
     options["MultiPV"] << Option(1, 1, MAX_MOVES);
+    options["Root Split"] << Option(false);
+    options["Exact Nodes"] << Option(false);
+    options["Lazy Stand Pat"] << Option(false);
     options["Skill Level"] << Option(20, 0, 20);
     options["Move Overhead"] << Option(10, 0, 5000);
     options["nodestime"] << Option(0, 0, 10000);
@@ -79,10 +100,16 @@ UCI::UCI(int argc, char** argv) :
     options["UCI_LimitStrength"] << Option(false);
     options["UCI_Elo"] << Option(1320, 1320, 3190);
     options["UCI_ShowWDL"] << Option(false);
+    options["Time Log"] << Option("");
+    options["Info Format"] << Option("uci var uci var json", "uci");
+    options["Info Interval"] << Option(0, 0, 5000);
     options["SyzygyPath"] << Option("<empty>", [](const Option& o) { Tablebases::init(o); });
     options["SyzygyProbeDepth"] << Option(1, 1, 100);
     options["Syzygy50MoveRule"] << Option(true);
     options["SyzygyProbeLimit"] << Option(7, 0, 7);
+    options["SyzygyNonBlocking"] << Option(false);
+    options["SyzygyCacheSize"] << Option(0, 0, 4096,
+                                         [](const Option& o) { Tablebases::resize_cache(o); });
     options["EvalFile"] << Option(EvalFileDefaultNameBig, [this](const Option& o) {
         networks.big.load(cli.binaryDirectory, o);
     });
@@ -93,7 +120,8 @@ UCI::UCI(int argc, char** argv) :
     networks.big.load(cli.binaryDirectory, options["EvalFile"]);
     networks.small.load(cli.binaryDirectory, options["EvalFileSmall"]);
 
-    threads.set({options, threads, tt, networks});
+    threads.set({options, threads, tt, networks}, size_t(options["Threads"]));
+    tt.resize(options["Hash"], options["Threads"]);
 
     search_clear();  // After threads are up
 }
@@ -112,7 +140,7 @@ void UCI::loop() {
     do
     {
         if (cli.argc == 1
-            && !getline(std::cin, cmd))  // Wait for an input or an end-of-file (EOF) indication
+            && !Cluster::read_command(cmd))  // Wait for an input or an end-of-file (EOF) indication
             cmd = "quit";
 
         std::istringstream is(cmd);
@@ -147,6 +175,8 @@ void UCI::loop() {
             search_clear();
         else if (token == "isready")
             sync_cout << "readyok" << sync_endl;
+        else if (token == "session")
+            session(is);
 
         // Add custom non-UCI commands, mainly for debugging purposes.
         // These commands must not be used during a search!
@@ -154,6 +184,20 @@ void UCI::loop() {
             pos.flip();
         else if (token == "bench")
             bench(pos, is, states);
+        else if (token == "evalbench")
+            evalbench(pos, is);
+        else if (token == "latencybench")
+            latencybench(pos, is, states);
+        else if (token == "smpbench")
+            smpbench(pos, is, states);
+        else if (token == "analyze")
+            analyze(is);
+        else if (token == "tmreplay")
+            tmreplay(is);
+        else if (token == "tbbench")
+            tbbench(is);
+        else if (token == "tbstats")
+            sync_cout << Tablebases::probe_stats() << sync_endl;
         else if (token == "d")
             sync_cout << pos << sync_endl;
         else if (token == "eval")
@@ -190,7 +234,7 @@ void UCI::loop() {
 }
 
 float UCI::curr_centipawn_eval_value(Stockfish::Position &pos){
-    Value v = Eval::evaluate(networks,pos,VALUE_ZERO);
+    Value v = Eval::evaluate(networks, *evalWorkspace, pos, VALUE_ZERO);
     int curr_cp_eval = UCI::to_cp(v,pos);
     return 0.01*curr_cp_eval;
 }
@@ -440,6 +484,13 @@ Search::LimitsType UCI::parse_limits(const Position& pos, std::istream& is) {
             is >> limits.mate;
         else if (token == "perft")
             is >> limits.perft;
+        else if (token == "perfthash")
+        {
+            is >> limits.perftHash;
+            limits.perftHash = std::clamp(limits.perftHash, 0, MaxHashMB);
+        }
+        else if (token == "perftstats")
+            limits.perftStats = true;
         else if (token == "infinite")
             limits.infinite = 1;
         else if (token == "ponder")
@@ -457,7 +508,8 @@ void UCI::go(Position& pos, std::istringstream& is, StateListPtr& states) {
 
     if (limits.perft)
     {
-        perft(pos.fen(), limits.perft, options["UCI_Chess960"]);
+        perft(pos.fen(), limits.perft, options["UCI_Chess960"], size_t(int(options["Threads"])),
+              size_t(limits.perftHash), limits.perftStats);
         return;
     }
 
@@ -466,7 +518,10 @@ void UCI::go(Position& pos, std::istringstream& is, StateListPtr& states) {
 
 void UCI::bench(Position& pos, std::istream& args, StateListPtr& states) {
     std::string token;
-    uint64_t    num, nodes = 0, cnt = 1;
+    uint64_t    num, nodes = 0, lazyEvals = 0, cnt = 1;
+#ifdef SEARCH_STATS
+    Search::SearchStats stats;
+#endif
 
     std::vector<std::string> list = setup_bench(pos, args);
 
@@ -488,7 +543,12 @@ void UCI::bench(Position& pos, std::istream& args, StateListPtr& states) {
             {
                 go(pos, is, states);
                 threads.main_thread()->wait_for_search_finished();
+                async_flush();  // Keep the search output in step with std::cerr
                 nodes += threads.nodes_searched();
+                lazyEvals += threads.lazy_evals();
+#ifdef SEARCH_STATS
+                stats += threads.search_stats();
+#endif
             }
             else
                 trace_eval(pos);
@@ -507,9 +567,508 @@ void UCI::bench(Position& pos, std::istream& args, StateListPtr& states) {
     elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
 
     dbg_print();
+    networks.big.sparse_input_stats(std::cerr);
+    networks.small.sparse_input_stats(std::cerr);
 
     std::cerr << "\n==========================="
               << "\nTotal time (ms) : " << elapsed << "\nNodes searched  : " << nodes
+              << "\nNodes/second    : " << 1000 * nodes / elapsed
+              << "\nLazy evaluations: " << lazyEvals << std::endl;
+
+#ifdef SEARCH_STATS
+    stats.print(std::cerr);
+#endif
+}
+
+// evalbench plays random moves from the bench positions (or the current one,
+// or those of a FEN file) and evaluates every position reached with both
+// networks, so that accumulators are updated incrementally as during search.
+// It reports evaluations per second and, per network, the time spent in the
+// feature transformer, the sparse first layer and the dense layers. The two
+// parameters are the number of plies played from each root position and the
+// FEN file. Example: evalbench 2000 default
+void UCI::evalbench(const Position& pos, std::istream& args) {
+
+    // Read like the limits of go, a value that is not a number reads as 0
+    std::string token, fenFile = "default";
+    int         plies = 1000;
+    args >> plies >> fenFile;
+
+    NN::NnueEvalProfile big{}, small{};
+    PRNG                rng(1070372);
+    Position            p;
+    StateListPtr        states;
+
+    TimePoint elapsed = now();
+
+    for (const auto& cmd : setup_evalbench(pos, fenFile))
+    {
+        std::istringstream is(cmd);
+        is >> std::skipws >> token;
+
+        if (token == "setoption")
+        {
+            setoption(is);
+            continue;
+        }
+
+        std::streampos root = is.tellg();
+        position(p, is, states);
+
+        for (int ply = 0; ply < plies; ++ply)
+        {
+            networks.big.profile_evaluate(p, evalWorkspace->big, big);
+            networks.small.profile_evaluate(p, evalWorkspace->small, small);
+
+            MoveList<LEGAL> moves(p);
+
+            // Start over from the root when the game is over
+            if (!moves.size() || p.is_draw(0))
+            {
+                is.clear();
+                is.seekg(root);
+                position(p, is, states);
+                continue;
+            }
+
+            states->emplace_back();
+            p.do_move(*(moves.begin() + rng.rand<std::uint64_t>() % moves.size()), states->back());
+        }
+    }
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    auto report = [](const char* name, const NN::NnueEvalProfile& prof) {
+        const std::uint64_t total =
+          std::max<std::uint64_t>(prof.transform + prof.sparse + prof.dense, 1);
+        const std::uint64_t evals = std::max<std::uint64_t>(prof.evals, 1);
+
+        auto stage = [&](std::uint64_t ns) {
+            std::ostringstream ss;
+            ss << ns / evals << " ns (" << 100 * ns / total << "%)";
+            return ss.str();
+        };
+
+        std::cerr << std::left << std::setw(8) << name << std::right << std::setw(13)
+                  << prof.evals * 1000000000 / total << std::setw(18) << stage(prof.transform)
+                  << std::setw(18) << stage(prof.sparse) << std::setw(18) << stage(prof.dense)
+                  << std::endl;
+    };
+
+    std::cerr << "\n==========================="
+              << "\nTotal time (ms) : " << elapsed
+              << "\nEvaluations     : " << big.evals + small.evals
+              << "\nEvals/second    : " << 1000 * (big.evals + small.evals) / elapsed << "\n\n"
+              << "Network   Evals/second         Transform         Sparse L1             Dense"
+              << std::endl;
+
+    report("big", big);
+    report("small", small);
+}
+
+// latencybench measures the wall time of short searches from the "go" command
+// to the end of the search, that is the cost of waking up the threads and
+// setting up the root on top of the search itself. The current position is
+// searched repeatedly with 1, 2, 4, ... threads. The three parameters are the
+// node limit, the maximum number of threads and the number of searches per
+// thread count. Example: latencybench 1000 256 100
+void UCI::latencybench(Position& pos, std::istream& args, StateListPtr& states) {
+
+    // Read like the limits of go, a value that is not a number reads as 0
+    int nodes = 1000, maxThreads = 256, repeats = 100;
+    args >> nodes >> maxThreads >> repeats;
+
+    nodes = std::max(nodes, 1), repeats = std::max(repeats, 1);
+
+    const int   threadsBefore = options["Threads"];
+    std::string goCmd         = "nodes " + std::to_string(nodes);
+    std::ostringstream table;
+
+    auto set_threads = [&](size_t n) {
+        std::istringstream is("name Threads value " + std::to_string(n));
+        setoption(is);
+    };
+
+    auto timed_go = [&]() {
+        std::istringstream is(goCmd);
+        auto               start = std::chrono::steady_clock::now();
+        go(pos, is, states);
+        threads.main_thread()->wait_for_search_finished();
+        double us =
+          std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+            .count();
+        async_flush();  // Out of the timing, keeps the search output in step with std::cerr
+        return us;
+    };
+
+    for (size_t n = 1; n <= size_t(std::clamp(maxThreads, 1, 1024)); n *= 2)
+    {
+        set_threads(n);
+        search_clear();
+        timed_go();  // Warm up the threads and their evaluation workspaces
+
+        std::vector<double> latency;
+        for (int i = 0; i < repeats; ++i)
+            latency.push_back(timed_go());
+
+        std::sort(latency.begin(), latency.end());
+        double sum = 0;
+        for (double l : latency)
+            sum += l;
+
+        table << std::setw(7) << n << std::fixed << std::setprecision(0) << std::setw(12)
+              << sum / repeats << std::setw(12) << latency[latency.size() / 2] << std::setw(12)
+              << latency.front() << std::setw(12) << latency.back() << "\n";
+    }
+
+    set_threads(size_t(threadsBefore));
+
+    std::cerr << "\n==========================="
+              << "\nNodes per search: " << nodes << "\nSearches        : " << repeats
+              << "\n\nThreads    avg (us) median (us)    min (us)    max (us)\n"
+              << table.str() << std::flush;
+}
+
+// smpbench measures the scaling of the parallel search: the bench positions
+// (or the current one, or those of a FEN file) are searched to a fixed depth
+// with 1, 2, 4, ... threads, and the time to depth and nodes per second are
+// compared with the single thread ones. The parameters are the depth, the
+// maximum number of threads, the hash size and the FEN file.
+// Example: smpbench 16 256 256 default
+void UCI::smpbench(Position& pos, std::istream& args, StateListPtr& states) {
+
+    // The depth and the hash size are checked by setup_bench(), the number of
+    // threads is read like the limits of go, a value that is not a number
+    // reading as 0.
+    std::string token, depth = "13", ttSize = "64", fenFile = "default";
+    int         maxThreads = 256;
+    args >> depth >> maxThreads >> ttSize >> fenFile;
+
+    const int          threadsBefore = options["Threads"], hashBefore = options["Hash"];
+    double             baseTime = 0, baseNps = 0;
+    std::ostringstream table;
+
+    for (size_t n = 1; n <= size_t(std::clamp(maxThreads, 1, 1024)); n *= 2)
+    {
+        std::istringstream benchArgs(ttSize + " " + std::to_string(n) + " " + depth + " " + fenFile
+                                     + " depth");
+        std::uint64_t      nodes   = 0;
+        TimePoint          elapsed = 0;
+
+        for (const auto& cmd : setup_bench(pos, benchArgs))
+        {
+            std::istringstream is(cmd);
+            is >> std::skipws >> token;
+
+            if (token == "go")
+            {
+                TimePoint start = now();
+                go(pos, is, states);
+                threads.main_thread()->wait_for_search_finished();
+                elapsed += now() - start;
+                nodes += threads.nodes_searched();
+                async_flush();
+            }
+            else if (token == "setoption")
+                setoption(is);
+            else if (token == "position")
+                position(pos, is, states);
+            else if (token == "ucinewgame")
+                search_clear();
+        }
+
+        elapsed    = std::max<TimePoint>(elapsed, 1);
+        double nps = 1000.0 * nodes / elapsed;
+
+        if (n == 1)
+            baseTime = double(elapsed), baseNps = nps;
+
+        table << std::setw(7) << n << std::setw(12) << elapsed << std::fixed
+              << std::setprecision(2) << std::setw(9) << baseTime / elapsed << std::setw(14)
+              << nodes << std::setw(12) << std::uint64_t(nps) << std::setprecision(1)
+              << std::setw(12) << 100 * nps / (n * baseNps) << "%\n";
+    }
+
+    // Restore the options set by setup_bench()
+    std::istringstream threadsIs("name Threads value " + std::to_string(threadsBefore));
+    std::istringstream hashIs("name Hash value " + std::to_string(hashBefore));
+    setoption(threadsIs);
+    setoption(hashIs);
+
+    std::cerr << "\n==========================="
+              << "\nDepth           : " << depth
+              << "\n\nThreads   time (ms)  speedup         nodes         nps  efficiency\n"
+              << table.str() << std::flush;
+}
+
+// tbbench measures the throughput of Tablebases::probe_wdl() with many threads
+// probing at once. The tables are reloaded first, so that the first accesses to
+// each table, that memory map it, contend too. The positions are random legal
+// placements of random materials up to the largest tables found, the same for
+// all the threads but probed from a different start. The parameters are the
+// number of threads and of probes per thread. Example: tbbench 128 100000
+void UCI::tbbench(std::istream& args) {
+
+    constexpr size_t PositionsNb = 256;
+
+    // Read like the limits of go, a value that is not a number reads as 0
+    int threadsArg = 16, probesArg = 100000;
+    args >> threadsArg >> probesArg;
+
+    size_t threadsNb = size_t(std::clamp(threadsArg, 1, 1024));
+    size_t probes    = size_t(std::max(probesArg, 0));
+
+    // The tablebases are reloaded, wait for the searches probing them to finish
+    if (!wait_for_searches())
+        return;
+    Tablebases::init(options["SyzygyPath"]);
+
+    if (Tablebases::MaxCardinality < 3)
+    {
+        sync_cout << "info string tbbench needs tablebases in SyzygyPath" << sync_endl;
+        return;
+    }
+
+    PRNG                     rng(1070372);
+    std::vector<std::string> fens;
+
+    while (fens.size() < PositionsNb)
+    {
+        std::string board(SQUARE_NB, ' ');
+        int         pieces = 3 + int(rng.rand<unsigned>() % (Tablebases::MaxCardinality - 2));
+
+        for (int i = 0; i < pieces; ++i)
+        {
+            char pc = i < 2 ? 'K' : " PNBRQ"[1 + rng.rand<unsigned>() % 5];
+            bool black = i < 2 ? i == 1 : rng.rand<unsigned>() & 1;
+            int  sq;
+
+            do  // No pawns on the first and last ranks
+                sq = pc == 'P' ? 8 + int(rng.rand<unsigned>() % 48)
+                               : int(rng.rand<unsigned>() % 64);
+            while (board[sq] != ' ');
+
+            board[sq] = black ? char(std::tolower(pc)) : pc;
+        }
+
+        std::string fen;
+        for (int r = 7; r >= 0; --r)
+        {
+            for (int f = 0, empty = 0; f < 8; ++f)
+            {
+                if (board[8 * r + f] == ' ')
+                    ++empty;
+                else
+                    fen += (empty ? std::to_string(empty) : "") + board[8 * r + f], empty = 0;
+
+                if (f == 7 && empty)
+                    fen += std::to_string(empty);
+            }
+            fen += r ? "/" : "";
+        }
+        fen += rng.rand<unsigned>() & 1 ? " b - - 0 1" : " w - - 0 1";
+
+        // Skip positions where the side to move can capture the king
+        StateInfo st;
+        Position  p;
+        p.set(fen, false, &st);
+
+        if (!(p.attackers_to(p.square<KING>(~p.side_to_move())) & p.pieces(p.side_to_move())))
+            fens.push_back(fen);
+    }
+
+    std::atomic<size_t>      readyNb{0}, hits{0};
+    std::atomic<bool>        start{false};
+    std::atomic<int64_t>     firstPass{0};
+    std::vector<std::thread> workers;
+
+    for (size_t idx = 0; idx < threadsNb; ++idx)
+        workers.emplace_back([&, idx]() {
+            std::vector<Position>  positions(PositionsNb);
+            std::vector<StateInfo> states(PositionsNb);
+
+            for (size_t i = 0; i < PositionsNb; ++i)
+                positions[i].set(fens[i], false, &states[i]);
+
+            ++readyNb;
+            while (!start)
+                std::this_thread::yield();
+
+            auto   begin = std::chrono::steady_clock::now();
+            size_t found = 0;
+
+            for (size_t i = 0; i < probes; ++i)
+            {
+                Tablebases::ProbeState err;
+                Tablebases::probe_wdl(positions[(i + idx * 37) % PositionsNb], &err);
+                found += err != Tablebases::FAIL;
+
+                // The first pass is done when all the positions were probed once
+                if (i + 1 == std::min(probes, PositionsNb))
+                {
+                    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now() - begin)
+                                   .count();
+                    for (int64_t prev = firstPass; prev < us
+                                                   && !firstPass.compare_exchange_weak(prev, us);)
+                    {}
+                }
+            }
+            hits += found;
+        });
+
+    while (readyNb < threadsNb)
+        std::this_thread::yield();
+
+    auto begin = std::chrono::steady_clock::now();
+    start      = true;
+
+    for (std::thread& th : workers)
+        th.join();
+
+    double elapsed =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cerr << "\n==========================="
+              << "\nThreads         : " << threadsNb
+              << "\nProbes          : " << threadsNb * probes
+              << "\nSuccessful      : " << hits
+              << "\nFirst pass (ms) : " << std::fixed << std::setprecision(1)
+              << firstPass / 1000.0
+              << "\nTotal time (ms) : " << elapsed
+              << "\nProbes/second   : " << std::setprecision(0)
+              << threadsNb * probes * 1000.0 / std::max(elapsed, 0.001) << std::endl;
+}
+
+// analyze searches all the positions of a file, one FEN per line, with one
+// thread per position. Each thread searches its own positions, taken from a
+// work-stealing queue, and all of them share the transposition table and the
+// networks, which stay warm from one position to the next. A line may end with
+// its own limits after a semicolon, for example "<fen> ; nodes 100000". The
+// other parameters are the default limits, "depth 10" if none, and the number
+// of threads. One JSON line is printed per position, in completion order.
+// Example: analyze positions.epd depth 16 threads 8
+void UCI::analyze(std::istream& args) {
+
+    struct Job {
+        std::string fen, limits;
+    };
+
+    std::string file, token, defaultLimits;
+    size_t      threadCount = size_t(options["Threads"]);
+
+    args >> file;
+
+    while (args >> token)
+        if (token == "threads")
+            args >> threadCount;
+        else
+            defaultLimits += token + " ";
+
+    if (defaultLimits.empty())
+        defaultLimits = "depth 10";
+
+    std::vector<Job> jobs;
+    std::ifstream    in(file);
+    std::string      line;
+
+    if (!in.is_open())
+    {
+        sync_cout << "info string Unable to open file " << file << sync_endl;
+        return;
+    }
+
+    while (std::getline(in, line))
+    {
+        size_t sep = line.find(';');
+        Job    job{line.substr(0, sep), sep == std::string::npos ? "" : line.substr(sep + 1)};
+
+        if (job.fen.find_first_not_of(" \t\r") == std::string::npos || job.fen[0] == '#')
+            continue;
+
+        if (job.limits.find_first_not_of(" \t\r") == std::string::npos)
+            job.limits = defaultLimits;
+
+        jobs.push_back(job);
+    }
+
+    networks.big.verify(options["EvalFile"]);
+    networks.small.verify(options["EvalFileSmall"]);
+
+    // The table is aged below, wait for the searches using it
+    if (!wait_for_searches())
+        return;
+
+    threadCount = std::clamp<size_t>(threadCount, 1, 1024);
+
+    // One single-threaded quiet session per thread, sharing the engine table,
+    // that is aged once for all the positions
+    tt.new_search();
+
+    std::vector<std::unique_ptr<Session>> workers;
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        workers.push_back(
+          std::make_unique<Session>(std::to_string(i), options, networks, tt, 1, 0, i));
+        workers.back()->threads.quiet = true;
+    }
+
+    WorkStealingQueue        queue;
+    std::atomic<uint64_t>    nodes{0};
+    std::vector<std::thread> feeders;
+
+    queue.reset(jobs.size(), threadCount);
+
+    TimePoint elapsed = now();
+
+    for (size_t i = 0; i < threadCount; ++i)
+        feeders.emplace_back([&, i]() {
+            Session& s = *workers[i];
+            size_t   idx;
+
+            while (queue.pop(i, idx))
+            {
+                std::istringstream fen("fen " + jobs[idx].fen);
+                std::istringstream limitsStream(jobs[idx].limits);
+                position(s.pos, fen, s.states);
+
+                Search::LimitsType limits = parse_limits(s.pos, limitsStream);
+                TimePoint          start  = now();
+
+                s.threads.start_thinking(options, s.pos, s.states, limits);
+                s.threads.main_thread()->wait_for_search_finished();
+                nodes += s.threads.nodes_searched();
+
+                const Search::RootMove& rm = s.threads.best_root_move();
+
+                Value v = rm.pv[0] == Move::none()
+                          ? (s.pos.checkers() ? -VALUE_MATE : VALUE_DRAW)
+                          : (rm.score != -VALUE_INFINITE ? rm.uciScore : rm.previousScore);
+                auto [unit, n] = score_parts(v, s.pos);
+
+                std::ostringstream json;
+                json << "{\"id\":" << idx << ",\"fen\":\"" << s.pos.fen()
+                     << "\",\"depth\":" << s.threads.completed_depth()
+                     << ",\"seldepth\":" << rm.selDepth << ",\"score\":{\"" << unit << "\":" << n
+                     << "},\"nodes\":" << s.threads.nodes_searched()
+                     << ",\"time\":" << now() - start << ",\"bestmove\":\""
+                     << move(rm.pv[0], s.pos.is_chess960()) << "\",\"pv\":[";
+
+                for (size_t j = 0; j < rm.pv.size() && rm.pv[0] != Move::none(); ++j)
+                    json << (j ? ",\"" : "\"") << move(rm.pv[j], s.pos.is_chess960()) << "\"";
+
+                sync_cout << json.str() << "]}" << sync_endl;
+            }
+        });
+
+    for (auto& feeder : feeders)
+        feeder.join();
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    std::cerr << "\n==========================="
+              << "\nPositions       : " << jobs.size() << "\nTotal time (ms) : " << elapsed
+              << "\nPositions/second: " << 1000.0 * jobs.size() / elapsed
               << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
 }
 
@@ -526,16 +1085,210 @@ void UCI::trace_eval(Position& pos) {
 }
 
 void UCI::search_clear() {
-    threads.main_thread()->wait_for_search_finished();
+    // The sessions probe the tablebases reloaded below
+    if (!wait_for_searches())
+        return;
 
     tt.clear(options["Threads"]);
     threads.clear();
     Tablebases::init(options["SyzygyPath"]);  // Free mapped files
 }
 
-void UCI::setoption(std::istringstream& is) {
+// Replays a "Time Log": the logged clocks are given again to TimeManagement,
+// with the current options, and the time bounds are compared to the logged
+// ones. Changing the options, or the constants in a TUNE build, between two
+// replays evaluates another policy without playing games. The time the new
+// policy would have spent is estimated by scaling the actual time of each move
+// by the ratio of the optimum times, capped at the new maximum.
+// Example: tmreplay time.log
+void UCI::tmreplay(std::istream& args) {
+
+    std::string fileName;
+    args >> fileName;
+
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        sync_cout << "info string cannot open " << fileName << sync_endl;
+        return;
+    }
+
+    TimeManagement tm;
+    TimeRecord     r;
+    int            moves = 0, cut = 0;
+    TimePoint      actual = 0, optimum = 0, replayOptimum = 0, estimated = 0;
+
+    while (file >> r)
+    {
+        if (!r.time)
+            continue;
+
+        Search::LimitsType limits;
+        limits.time[WHITE] = r.time;
+        limits.inc[WHITE]  = r.inc;
+        limits.movestogo   = r.movestogo;
+        limits.startTime   = now();
+
+        tm.clear();
+        tm.init(limits, WHITE, r.ply, options);
+
+        double    scale = double(tm.optimum()) / std::max(TimePoint(1), r.optimum);
+        TimePoint est   = std::min(TimePoint(r.actual * scale), tm.maximum());
+
+        est = std::max(TimePoint(0), est);
+
+        ++moves;
+        cut += r.actual > tm.maximum() && tm.maximum() < r.maximum;
+        actual += r.actual;
+        optimum += r.optimum;
+        replayOptimum += tm.optimum();
+        estimated += est;
+
+        sync_cout << "ply " << r.ply << " time " << r.time << " actual " << r.actual << " stop "
+                  << r.stop << " optimum " << r.optimum << " -> " << tm.optimum() << " maximum "
+                  << r.maximum << " -> " << tm.maximum() << " estimated " << est << sync_endl;
+    }
+
+    sync_cout << "\nMoves replayed       : " << moves << "\nActual time (ms)     : " << actual
+              << "\nLogged optimum (ms)  : " << optimum
+              << "\nReplayed optimum (ms): " << replayOptimum
+              << "\nEstimated time (ms)  : " << estimated
+              << "\nCut by new maximum   : " << cut << sync_endl;
+}
+
+// Waits for the searches using the engine transposition table, the ones of
+// the sessions sharing it included, so that it can be resized or cleared.
+void UCI::wait_for_shared_tt() {
     threads.main_thread()->wait_for_search_finished();
-    options.setoption(is);
+
+    for (auto& [id, s] : sessions)
+        if (s->shares_tt())
+            s->threads.main_thread()->wait_for_search_finished();
+}
+
+// Waits for all the searches, the ones of every session included. They share
+// the options, the networks and the tablebases, that cannot change under them.
+// An infinite or pondering search only ends on a later command of this loop,
+// so while one runs nothing is waited for and false is returned.
+bool UCI::wait_for_searches() {
+    bool open = threads.waits_for_stop();
+
+    for (auto& [id, s] : sessions)
+        open |= s->threads.waits_for_stop();
+
+    if (open)
+    {
+        sync_cout << "info string an infinite or pondering search is running, stop it first"
+                  << sync_endl;
+        return false;
+    }
+
+    threads.main_thread()->wait_for_search_finished();
+
+    for (auto& [id, s] : sessions)
+        s->threads.main_thread()->wait_for_search_finished();
+
+    return true;
+}
+
+// Handles "session <id> <command> ...", running a search of its own in the
+// session <id>. Sessions are opened with "session <id> open [threads n]
+// [hash mb]", where a hash of 0 (the default) shares the engine table, and
+// then take the position, go, stop, ponderhit, ucinewgame, isready, d and
+// close commands with the usual UCI syntax. All the output of a session is
+// prefixed with "session <id> ".
+void UCI::session(std::istringstream& is) {
+    std::string id, token;
+
+    if (!(is >> id >> token))
+    {
+        sync_cout << "info string usage: session <id> <command>" << sync_endl;
+        return;
+    }
+
+    auto it = sessions.find(id);
+
+    if (token == "open")
+    {
+        size_t threadCount = 1, hashMB = 0;
+
+        while (is >> token)
+            if (token == "threads")
+                is >> threadCount;
+            else if (token == "hash")
+                is >> hashMB;
+
+        threadCount = std::clamp<size_t>(threadCount, 1, 1024);
+        hashMB      = std::min<size_t>(hashMB, MaxHashMB);
+
+        // Place the threads of the new session after all the existing ones
+        size_t bindingOffset = size_t(options["Threads"]);
+        for (auto& [other, s] : sessions)
+            bindingOffset += other == id ? 0 : s->threads.size();
+
+        sessions.erase(id);
+        auto& s = sessions[id] = std::make_unique<Session>(id, options, networks, tt, threadCount,
+                                                           hashMB, bindingOffset);
+
+        std::istringstream startpos("startpos");
+        position(s->pos, startpos, s->states);
+        return;
+    }
+
+    if (it == sessions.end())
+    {
+        sync_cout << "info string session " << id << " is not open" << sync_endl;
+        return;
+    }
+
+    Session& s = *it->second;
+
+    // Neither wait for an infinite or pondering search of the session, that
+    // only a later stop or ponderhit of this loop ends
+    if ((token == "position" || token == "go" || token == "ucinewgame")
+        && s.threads.waits_for_stop())
+    {
+        sync_cout << "info string session " << id << " is searching, stop it first" << sync_endl;
+        return;
+    }
+
+    if (token == "close")
+        sessions.erase(it);
+    else if (token == "stop")
+        s.threads.stop = true;
+    else if (token == "ponderhit")
+        s.threads.main_manager()->ponder = false;
+    else if (token == "position")
+    {
+        s.threads.main_thread()->wait_for_search_finished();
+        position(s.pos, is, s.states);
+    }
+    else if (token == "go")
+    {
+        Search::LimitsType limits = parse_limits(s.pos, is);
+
+        networks.big.verify(options["EvalFile"]);
+        networks.small.verify(options["EvalFileSmall"]);
+
+        s.threads.start_thinking(options, s.pos, s.states, limits);
+    }
+    else if (token == "ucinewgame")
+        s.clear();
+    else if (token == "isready")
+    {
+        if (!s.threads.waits_for_stop())
+            s.threads.main_thread()->wait_for_search_finished();
+        sync_cout << s.threads.tag << "readyok" << sync_endl;
+    }
+    else if (token == "d")
+        sync_cout << s.threads.tag << "\n" << s.pos << sync_endl;
+    else
+        sync_cout << "info string unknown session command: " << token << sync_endl;
+}
+
+void UCI::setoption(std::istringstream& is) {
+    if (wait_for_searches())
+        options.setoption(is);
 }
 
 void UCI::position(Position& pos, std::istringstream& is, StateListPtr& states) {
@@ -597,21 +1350,26 @@ int win_rate_model(Value v, const Position& pos) {
 }
 
 std::string UCI::to_score(Value v, const Position& pos) {
-    assert(-VALUE_INFINITE < v && v < VALUE_INFINITE);
 
-    std::stringstream ss;
+    auto [unit, n] = score_parts(v, pos);
+
+    return std::string(unit) + " " + std::to_string(n);
+}
+
+// Splits a score into the unit of to_score(), "cp" or "mate", and its number
+std::pair<const char*, int> UCI::score_parts(Value v, const Position& pos) {
+    assert(-VALUE_INFINITE < v && v < VALUE_INFINITE);
 
     if (std::abs(v) < VALUE_TB_WIN_IN_MAX_PLY)
-        ss << "cp " << to_cp(v, pos);
-    else if (std::abs(v) <= VALUE_TB)
+        return {"cp", to_cp(v, pos)};
+
+    if (std::abs(v) <= VALUE_TB)
     {
         const int ply = VALUE_TB - std::abs(v);  // recompute ss->ply
-        ss << "cp " << (v > 0 ? 20000 - ply : -20000 + ply);
+        return {"cp", v > 0 ? 20000 - ply : -20000 + ply};
     }
-    else
-        ss << "mate " << (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2;
 
-    return ss.str();
+    return {"mate", (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2};
 }
 
 // Turns a Value to an integer centipawn number,
@@ -630,12 +1388,19 @@ int UCI::to_cp(Value v, const Position& pos) {
 std::string UCI::wdl(Value v, const Position& pos) {
     std::stringstream ss;
 
+    auto [wdl_w, wdl_d, wdl_l] = wdl_parts(v, pos);
+    ss << " wdl " << wdl_w << " " << wdl_d << " " << wdl_l;
+
+    return ss.str();
+}
+
+std::array<int, 3> UCI::wdl_parts(Value v, const Position& pos) {
+
     int wdl_w = win_rate_model(v, pos);
     int wdl_l = win_rate_model(-v, pos);
     int wdl_d = 1000 - wdl_w - wdl_l;
-    ss << " wdl " << wdl_w << " " << wdl_d << " " << wdl_l;
 
-    return ss.str();
+    return {wdl_w, wdl_d, wdl_l};
 }
 
 std::string UCI::square(Square s) {
@@ -19,13 +19,19 @@
 #ifndef UCI_H_INCLUDED
 #define UCI_H_INCLUDED
 
+#include <array>
+#include <cstddef>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "misc.h"
 #include "nnue/network.h"
 #include "position.h"
 #include "search.h"
+#include "session.h"
 #include "thread.h"
 #include "tt.h"
 #include "ucioption.h"
@@ -42,12 +48,14 @@ class UCI {
 
     void loop();
 
-    static int         to_cp(Value v, const Position& pos);
-    static std::string to_score(Value v, const Position& pos);
-    static std::string square(Square s);
-    static std::string move(Move m, bool chess960);
-    static std::string wdl(Value v, const Position& pos);
-    static Move        to_move(const Position& pos, std::string& str);
+    static int                         to_cp(Value v, const Position& pos);
+    static std::string                 to_score(Value v, const Position& pos);
+    static std::pair<const char*, int> score_parts(Value v, const Position& pos);
+    static std::string                 square(Square s);
+    static std::string                 move(Move m, bool chess960);
+    static std::string                 wdl(Value v, const Position& pos);
+    static std::array<int, 3>          wdl_parts(Value v, const Position& pos);
+    static Move                        to_move(const Position& pos, std::string& str);
 
     static Search::LimitsType parse_limits(const Position& pos, std::istream& is);
 
@@ -61,11 +69,26 @@ class UCI {
     ThreadPool         threads;
     CommandLine        cli;
 
+    // Concurrent search sessions by id, see UCI::session()
+    std::map<std::string, std::unique_ptr<Session>> sessions;
+
+    // Evaluation scratch memory for commands evaluating outside of a search
+    std::unique_ptr<Eval::NNUE::EvalWorkspace> evalWorkspace;
+
     void go(Position& pos, std::istringstream& is, StateListPtr& states);
     void bench(Position& pos, std::istream& args, StateListPtr& states);
+    void evalbench(const Position& pos, std::istream& args);
+    void latencybench(Position& pos, std::istream& args, StateListPtr& states);
+    void smpbench(Position& pos, std::istream& args, StateListPtr& states);
+    void tbbench(std::istream& args);
+    void analyze(std::istream& args);
+    void tmreplay(std::istream& args);
     void position(Position& pos, std::istringstream& is, StateListPtr& states);
     void trace_eval(Position& pos);
     void search_clear();
+    void wait_for_shared_tt();
+    bool wait_for_searches();
+    void session(std::istringstream& is);
     void setoption(std::istringstream& is);
     void cs433_project(Stockfish::Position& pos, std::istringstream& is, Stockfish::StateListPtr& states);
     float curr_centipawn_eval_value(Stockfish::Position &pos);
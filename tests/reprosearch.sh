@@ -58,4 +58,39 @@ done
 
 rm repeat.exp
 
+# with Exact Nodes the last info line of go nodes $nodes
+# should report exactly $nodes, whatever the number of threads.
+cat << EOF > exact.exp
+ set timeout 10
+ spawn ./stockfish
+ lassign \$argv threads nodes
+
+ send "uci\n"
+ expect "uciok"
+
+ send "setoption name Exact Nodes value true\n"
+ send "setoption name Threads value \$threads\n"
+ send "position startpos moves e2e4 e7e6\n"
+ send "go nodes \$nodes\n"
+ expect "bestmove"
+
+ send "quit\n"
+ expect eof
+EOF
+
+for threads in 1 4
+do
+
+  for nodes in 20000 123457
+  do
+
+    echo "reprosearch testing exact nodes with $threads threads and $nodes nodes"
+    expect exact.exp $threads $nodes 2>&1 | grep -o "nodes [0-9]*" | tail -1 | grep -qx "nodes $nodes"
+
+  done
+
+done
+
+rm exact.exp
+
 echo "reprosearch testing OK"